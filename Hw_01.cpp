@@ -1,9 +1,26 @@
 #include <iostream>
 #include <cmath>
+#include <vector>
+#ifdef _WIN32
 #include "glut.h"
+#else
+#include <GL/glut.h>
+#endif
+
+#include "tessellator.h"
 using namespace std;
 int n;
 
+// Polygon vertices (x, y pairs), rebuilt only when n changes
+vector<GLfloat> polygon;
+int polygonSides = 0;
+
+// n == 0 draws a circle tessellated for the current window size
+CircleTessellator tessellator;
+const float TOLERANCE_PX = 0.5f;
+int windowWidth = 500;
+int windowHeight = 500;
+
 void init() {
     glClearColor(0.0, 0.0, 0.0, 0.0);
     glColor3f(1.0, 1.0, 1.0);
@@ -13,24 +30,62 @@ void init() {
 }// 
 
 
+void buildPolygon(int sides) {
+    float radius = 0.25;
+    polygon.resize(2 * sides);
+
+    // Rotate (c, s) by a fixed step instead of calling cos/sin per vertex.
+    // In double precision the drift stays far below a pixel even for
+    // millions of vertices.
+    double step = 2.0 * 3.14159265358979323846 / sides;
+    double cd = cos(step), sd = sin(step);
+    double c = 1.0, s = 0.0;
+    for (int i = 0; i < sides; i++) {
+        polygon[2 * i] = (GLfloat)(radius * c);
+        polygon[2 * i + 1] = (GLfloat)(radius * s);
+        double nc = c * cd - s * sd;
+        s = c * sd + s * cd;
+        c = nc;
+    }
+    polygonSides = sides;
+}
+
+void reshape(int w, int h) {
+    windowWidth = w;
+    windowHeight = h;
+    glViewport(0, 0, w, h);
+}
+
 void display() {
-    float theta;
-    float radius = 0.25; 
+    float radius = 0.25;
     glClear(GL_COLOR_BUFFER_BIT);
-    glBegin(GL_LINE_LOOP); 
 
-    for (int i = 0; i < n; i++) {
-        theta = 2.0f * 3.1415926f * i / n;
-        float x = radius * cos(theta);
-        float y = radius * sin(theta);
-        glVertex2f(x, y);
+    if (n == 0) {
+        // The ortho view stretches 1 unit over each side of the window, so
+        // on a non-square window the circle's long axis is on the longer side
+        float radiusPx = radius * max(windowWidth, windowHeight);
+        const vector<float> &circle = tessellator.unitCircle(radiusPx, TOLERANCE_PX);
+
+        glPushMatrix();
+        glScalef(radius, radius, 1.0f);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glVertexPointer(2, GL_FLOAT, 0, &circle[0]);
+        glDrawArrays(GL_LINE_LOOP, 0, (GLsizei)(circle.size() / 2));
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glPopMatrix();
+    } else if (n > 0) {
+        if (n != polygonSides) buildPolygon(n);
+
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glVertexPointer(2, GL_FLOAT, 0, &polygon[0]);
+        glDrawArrays(GL_LINE_LOOP, 0, n);
+        glDisableClientState(GL_VERTEX_ARRAY);
     }
-    glEnd();
     glFlush();
 }
 
 int main(int argc, char** argv) {
-    cout << "input parameter：";
+    cout << "input parameter (0 = circle)：";
     cin >> n;
         glutInit(&argc, argv);
         glutInitDisplayMode(GLUT_SINGLE | GLUT_RGB);
@@ -38,9 +93,10 @@ int main(int argc, char** argv) {
         glutInitWindowPosition(0, 0);
         glutCreateWindow("Regular Polygon");
         glutDisplayFunc(display);
+        glutReshapeFunc(reshape);
         init();
         glutMainLoop();
-    
+        return 0;
 }
 
 
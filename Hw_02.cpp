@@ -1,7 +1,23 @@
+#include <chrono>
 #include <iostream>
-#include <windows.h>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+
 #include "glut.h"
+#else
+#include <GL/glut.h>
+#endif
+
+#include "frame_pacer.h"
+#include "tessellator.h"
+#include "text_cache.h"
+#include "worker_pool.h"
 #define PI 3.14159 
 using namespace std;
 
@@ -10,7 +26,59 @@ float xx = 0.0;
 float yy = 0.0;
 bool wise = 0;
 
+// Rotation speed in degrees per second; 60 matches the old 1 degree per
+// idle tick at 60 Hz
+const float ANGULAR_SPEED = 60.0f;
+typedef chrono::steady_clock clock_type;
+clock_type::time_point lastIdle = clock_type::now();
+bool animating = false;  // idle() installed
+
+// Frame cap when vsync is unavailable or turned off, 0 = uncapped
+FramePacer pacer(60.0);
+bool vsync = false;
+
+// Frame-rate readout, refreshed twice a second
+struct FrameStats {
+    clock_type::time_point lastFrame;
+    clock_type::time_point windowStart;
+    int frames;
+    double minMs, maxMs;
+    char text[96];
+};
+FrameStats frameStats;
+bool showStats = true;
+TextCache textCache;  // the stats line is rebuilt only when its text changes
+
+// Ellipse segment count follows its on-screen size
+CircleTessellator tessellator;
+const float TOLERANCE_PX = 0.5f;
+int windowWidth = 500;
+int windowHeight = 500;
+
+// Particle mode: many independent ellipses in structure-of-arrays form.
+// Rotation is kept as (c, s) and advanced by a per-particle step rotation,
+// so the update is multiply-adds only and vectorizes.
+struct Particles {
+    int count;
+    vector<float> c, s;          // current rotation
+    vector<float> stepC, stepS;  // rotation per SIM_STEP
+    vector<float> dir;           // +1 counterclockwise, -1 clockwise
+    vector<float> px, py;        // position
+    vector<float> vx, vy;        // velocity per SIM_STEP
+    vector<float> vertices;      // expanded GL_LINES, 4 floats per segment
+    const vector<float> *shape;  // unit circle used by expandParticles()
+};
+
+const float PARTICLE_SCALE = 0.05f;
+const float SIM_STEP = 1.0f / 120.0f;  // particles advance on a fixed step
+float simAccumulator = 0.0f;
+Particles particles;
+unsigned int workerCount = max(1u, thread::hardware_concurrency());
+WorkerPool workers((int)workerCount);
+
 void idle();
+void startAnimation();
+void stopAnimation();
 void myMenu(int id);
 void init();
 void myMenu(int id);
@@ -18,8 +86,31 @@ void reshape(int x, int y);
 void display();
 void mouse(GLint button, GLint state, GLint x, GLint y);
 void keyboard(unsigned char key, GLint x, GLint y);
+void benchTessellation();
+void benchEllipse();
+void ellipseVerticesCPU(int num_segments, float *out);
+void initParticles(int count);
+void updateParticles(int begin, int end);
+void expandParticles(int begin, int end);
+void parallelFor(int count, void (*kernel)(int, int));
+void benchParticles(int count);
+void updateFrameStats();
+void drawFrameStats();
 
 int main(int argc, char** argv) {
+        if (argc > 1 && strcmp(argv[1], "--bench-tess") == 0) {
+            benchTessellation();
+            return 0;
+        }
+        if (argc > 1 && strcmp(argv[1], "--bench-ellipse") == 0) {
+            benchEllipse();
+            return 0;
+        }
+        if (argc > 1 && strcmp(argv[1], "--bench-particles") == 0) {
+            benchParticles(argc > 2 ? atoi(argv[2]) : 1000000);
+            return 0;
+        }
+
         glutInit(&argc, argv);
         glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB);
         glutInitWindowSize(500, 500);
@@ -27,7 +118,7 @@ int main(int argc, char** argv) {
         glutCreateWindow("HW_02");
 
         glutDisplayFunc(display);   
-        glutIdleFunc(idle);         
+        startAnimation();
 
         glutMouseFunc(mouse);       
         glutKeyboardFunc(keyboard); 
@@ -35,6 +126,7 @@ int main(int argc, char** argv) {
 
         init();
         glutMainLoop();
+        return 0;
 }
 
 
@@ -47,10 +139,10 @@ void myMenu(int id) {
 void myRotation(int id) {
     switch(id) {
     case 0:
-        glutIdleFunc(idle);
+        startAnimation();
         break;
     case 1:
-        glutIdleFunc(NULL);
+        stopAnimation();
         break;
     default:
         break;
@@ -68,7 +160,7 @@ void myDirection(int id) {
     default:
         break;
     }
-    glutIdleFunc(idle);
+    startAnimation();
 }
 
 void myTranslation(int id) {
@@ -88,7 +180,25 @@ void myTranslation(int id) {
     default:
         break;
     }
-    glutIdleFunc(idle);
+    startAnimation();
+}
+
+void myParticles(int id) {
+    // id is the particle count, 0 returns to the single ellipse
+    initParticles(id);
+    startAnimation();
+}
+
+void myFrameCap(int id) {
+    // 0 = vsync, 1 = uncapped, otherwise the cap in frames per second
+    if (id == 0) {
+        vsync = setSwapInterval(1);
+        pacer.setTargetFps(vsync ? 0.0 : 60.0);
+    } else {
+        setSwapInterval(0);
+        vsync = false;
+        pacer.setTargetFps(id == 1 ? 0.0 : id);
+    }
 }
 
 void init() {  
@@ -107,31 +217,82 @@ void init() {
     glutAddMenuEntry("Increase y", 2);
     glutAddMenuEntry("Decrease y", 3);
 
+    int sub_Particles = glutCreateMenu(myParticles);
+    glutAddMenuEntry("Single ellipse", 0);
+    glutAddMenuEntry("1,000 ellipses", 1000);
+    glutAddMenuEntry("100,000 ellipses", 100000);
+    glutAddMenuEntry("1,000,000 ellipses", 1000000);
+
+    int sub_FrameCap = glutCreateMenu(myFrameCap);
+    glutAddMenuEntry("VSync", 0);
+    glutAddMenuEntry("30 FPS", 30);
+    glutAddMenuEntry("60 FPS", 60);
+    glutAddMenuEntry("144 FPS", 144);
+    glutAddMenuEntry("Uncapped", 1);
+
 
     /* set the main menu */
     glutCreateMenu(myMenu);
     glutAddSubMenu("Rotation", sub_Rotation);
     glutAddSubMenu("Direction", sub_Direction);
     glutAddSubMenu("Translation", sub_Translation);
+    glutAddSubMenu("Particles", sub_Particles);
+    glutAddSubMenu("Frame Cap", sub_FrameCap);
     glutAddMenuEntry("Quit", 1);
 
 
     glutAttachMenu(GLUT_RIGHT_BUTTON);
     glClearColor(0.0, 0.0, 0.0, 0.0);
 
+    // Let the swap pace frames when the driver allows it
+    myFrameCap(0);
+    frameStats.lastFrame = frameStats.windowStart = clock_type::now();
+    frameStats.frames = 0;
+    frameStats.minMs = 1e9;
+    frameStats.maxMs = 0.0;
+    frameStats.text[0] = '\0';
+}
+
+// Restarting resets the clock, so the time spent stopped is not played
+// back as one step
+void startAnimation() {
+    if (!animating) lastIdle = clock_type::now();
+    animating = true;
+    glutIdleFunc(idle);
+}
+
+void stopAnimation() {
+    animating = false;
+    glutIdleFunc(NULL);
 }
 
 void idle() {
-    theta += (wise ? -1: 1);
-    if (theta >= 360.0)
-        theta = 0.0;
+    clock_type::time_point now = clock_type::now();
+    // Clamp so a stalled frame (a window drag, a breakpoint) does not jump
+    float dt = (float)min(chrono::duration<double>(now - lastIdle).count(), 0.1);
+    lastIdle = now;
+
+    theta += (wise ? -1: 1) * ANGULAR_SPEED * dt;
+    theta = fmod(theta, 360.0f);
+    if (theta < 0.0f)
+        theta += 360.0f;
+
+    if (particles.count > 0) {
+        simAccumulator += dt;
+        while (simAccumulator >= SIM_STEP) {
+            parallelFor(particles.count, updateParticles);
+            simAccumulator -= SIM_STEP;
+        }
+    }
 
-    Sleep(1);
+    pacer.wait();
     glutPostRedisplay();
 }
 
 void reshape(int x, int y) {
-
+    windowWidth = x;
+    windowHeight = y;
+    glViewport(0, 0, x, y);
 }
 
 void display() {
@@ -146,23 +307,44 @@ void display() {
 
     glColor3f(0.0, 0.0, 1.0); 
 
-    int num_segments = 200; 
-
-    float thetar = theta * PI / (180);
-
-    glBegin(GL_LINE_LOOP);
-    for (int i = 0; i < num_segments; i++) {
-        float angle = 2.0f * 3.14159f * i / num_segments;
-        float x = 0.2 * cos(angle);
-        float y = 0.4 * sin(angle);
-
-        float px, py;
-        px = x * cos(thetar) + y * sin(thetar) + xx;
-        py = -x * sin(thetar) + y * cos(thetar) + yy;
-        glVertex2f(px, py);
+    if (particles.count > 0) {
+        // Rotated like the single ellipse, so sized the same way
+        float particlePx = PARTICLE_SCALE * 0.4f * max(windowWidth, windowHeight) / 2.0f;
+        const vector<float> &shape = tessellator.unitCircle(particlePx, TOLERANCE_PX);
+        size_t floats = (size_t)particles.count * shape.size() * 2;
+        if (particles.vertices.size() != floats) particles.vertices.resize(floats);
+
+        // Worker threads expand every instance into one vertex array,
+        // submitted with a single draw call
+        particles.shape = &shape;
+        parallelFor(particles.count, expandParticles);
+
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glVertexPointer(2, GL_FLOAT, 0, &particles.vertices[0]);
+        glDrawArrays(GL_LINES, 0, (GLsizei)(floats / 2));
+        glDisableClientState(GL_VERTEX_ARRAY);
+    } else {
+        // Semi-axes 0.2 and 0.4 in NDC; rotated, the 0.4 one can lie along
+        // either axis, so size it by the larger window dimension
+        float radiusPx = 0.4f * max(windowWidth, windowHeight) / 2.0f;
+        const vector<float> &circle = tessellator.unitCircle(radiusPx, TOLERANCE_PX);
+
+        // px = x cos + y sin + xx, py = -x sin + y cos + yy is a rotation by
+        // -theta followed by the translation, so it fits one model matrix
+        glPushMatrix();
+        glTranslatef(xx, yy, 0.0f);
+        glRotatef(-theta, 0.0f, 0.0f, 1.0f);
+        glScalef(0.2f, 0.4f, 1.0f);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glVertexPointer(2, GL_FLOAT, 0, &circle[0]);
+        glDrawArrays(GL_LINE_LOOP, 0, (GLsizei)(circle.size() / 2));
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glPopMatrix();
     }
 
-    glEnd();
+    updateFrameStats();
+    if (showStats) drawFrameStats();
+
     glFlush();
     glutSwapBuffers();
 }
@@ -176,7 +358,7 @@ void mouse(GLint button, GLint state, GLint x, GLint y) {
 
     case GLUT_RIGHT_BUTTON:
         if (state == GLUT_DOWN)
-            glutIdleFunc(NULL);
+            stopAnimation();
         break;
     default:
         break;
@@ -187,4 +369,251 @@ void mouse(GLint button, GLint state, GLint x, GLint y) {
 void keyboard(unsigned char key, GLint x, GLint y) {
     if (key == 'q' || key == 'Q')
         exit(0);
+    if (key == 'f' || key == 'F') {
+        showStats = !showStats;
+        glutPostRedisplay();
+    }
+}
+
+void updateFrameStats() {
+    clock_type::time_point now = clock_type::now();
+    double ms = chrono::duration<double, milli>(now - frameStats.lastFrame).count();
+    frameStats.lastFrame = now;
+    frameStats.frames++;
+    frameStats.minMs = min(frameStats.minMs, ms);
+    frameStats.maxMs = max(frameStats.maxMs, ms);
+
+    double elapsed = chrono::duration<double>(now - frameStats.windowStart).count();
+    if (elapsed < 0.5) return;
+
+    char cap[16];
+    if (vsync) {
+        snprintf(cap, sizeof(cap), "vsync");
+    } else if (pacer.getTargetFps() > 0.0) {
+        snprintf(cap, sizeof(cap), "%.0f", pacer.getTargetFps());
+    } else {
+        snprintf(cap, sizeof(cap), "off");
+    }
+    snprintf(frameStats.text, sizeof(frameStats.text), "%.1f FPS  %.2f ms (min %.2f, max %.2f)  cap %s",
+             frameStats.frames / elapsed, 1000.0 * elapsed / frameStats.frames, frameStats.minMs, frameStats.maxMs,
+             cap);
+    frameStats.windowStart = now;
+    frameStats.frames = 0;
+    frameStats.minMs = 1e9;
+    frameStats.maxMs = 0.0;
+}
+
+void drawFrameStats() {
+    glColor3f(1.0, 1.0, 1.0);
+    TextCache::draw(textCache.slot(0, GLUT_BITMAP_HELVETICA_12, frameStats.text), -0.97f, 0.93f);
+}
+
+void benchTessellation() {
+    const int FIXED_SEGMENTS = 200;
+
+    cout << "zoom  radius_px  adaptive_segments  fixed_segments  fixed_error_px  vertex_savings" << endl;
+    long adaptiveTotal = 0, fixedTotal = 0;
+    for (float zoom = 1.0f / 16.0f; zoom <= 64.0f; zoom *= 2.0f) {
+        // Larger semi-axis of the Hw_02 ellipse in a 500x500 window
+        float radiusPx = 0.4f * 250.0f * zoom;
+        int adaptive = (int)(tessellator.unitCircle(radiusPx, TOLERANCE_PX).size() / 2);
+        double fixedError = radiusPx * (1.0 - cos(PI / FIXED_SEGMENTS));
+        adaptiveTotal += adaptive;
+        fixedTotal += FIXED_SEGMENTS;
+        cout << zoom << "  " << radiusPx << "  " << adaptive << "  " << FIXED_SEGMENTS << "  " << fixedError << "  "
+             << 100.0 * (FIXED_SEGMENTS - adaptive) / FIXED_SEGMENTS << "%" << endl;
+    }
+    cout << "total vertices: adaptive " << adaptiveTotal << ", fixed " << fixedTotal << endl;
+
+    // Cost of a cached lookup, as paid once per frame by display()
+    const int LOOKUPS = 1000000;
+    size_t sink = 0;
+    clock_type::time_point t0 = clock_type::now();
+    for (int i = 0; i < LOOKUPS; i++) {
+        sink += tessellator.unitCircle(50.0f + (i & 255), TOLERANCE_PX).size();
+    }
+    clock_type::time_point t1 = clock_type::now();
+    cout << "cached lookup: " << chrono::duration<double, nano>(t1 - t0).count() / LOOKUPS << " ns, "
+         << tessellator.cachedTables() << " tables, " << sink / 2.0 / LOOKUPS << " vertices on average" << endl;
+}
+
+// Previous display() path, every vertex rotated and translated on the CPU.
+// Kept as the baseline for --bench-ellipse.
+void ellipseVerticesCPU(int num_segments, float *out) {
+    float thetar = theta * PI / (180);
+
+    for (int i = 0; i < num_segments; i++) {
+        float angle = 2.0f * 3.14159f * i / num_segments;
+        float x = 0.2 * cos(angle);
+        float y = 0.4 * sin(angle);
+
+        float px, py;
+        px = x * cos(thetar) + y * sin(thetar) + xx;
+        py = -x * sin(thetar) + y * cos(thetar) + yy;
+        out[2 * i] = px;
+        out[2 * i + 1] = py;
+    }
+}
+
+void benchEllipse() {
+    const int FRAMES = 100000;
+    const int num_segments = 200;
+    vector<float> vertices(2 * num_segments);
+    float sink = 0.0f;
+
+    clock_type::time_point t0 = clock_type::now();
+    for (int f = 0; f < FRAMES; f++) {
+        theta = (float)(f % 360);
+        ellipseVerticesCPU(num_segments, &vertices[0]);
+        sink += vertices[f % (2 * num_segments)];
+    }
+    clock_type::time_point t1 = clock_type::now();
+
+    // Matrix path: per frame only the model matrix changes, this is the
+    // work glTranslatef/glRotatef/glScalef do
+    float m[16];
+    for (int f = 0; f < FRAMES; f++) {
+        theta = (float)(f % 360);
+        float r = -theta * PI / 180.0f;
+        float c = cos(r), s = sin(r);
+        m[0] = 0.2f * c;  m[4] = -0.4f * s; m[8] = 0.0f;  m[12] = xx;
+        m[1] = 0.2f * s;  m[5] = 0.4f * c;  m[9] = 0.0f;  m[13] = yy;
+        m[2] = 0.0f;      m[6] = 0.0f;      m[10] = 1.0f; m[14] = 0.0f;
+        m[3] = 0.0f;      m[7] = 0.0f;      m[11] = 0.0f; m[15] = 1.0f;
+        sink += m[f & 15];
+    }
+    clock_type::time_point t2 = clock_type::now();
+
+    double cpuNs = chrono::duration<double, nano>(t1 - t0).count() / FRAMES;
+    double matrixNs = chrono::duration<double, nano>(t2 - t1).count() / FRAMES;
+    cout << "CPU vertex path:  " << cpuNs << " ns/frame (" << num_segments << " vertices)" << endl;
+    cout << "Model matrix:     " << matrixNs << " ns/frame" << endl;
+    cout << "speedup:          " << cpuNs / matrixNs << "x (checksum " << sink << ")" << endl;
+}
+
+void initParticles(int count) {
+    const float RAD = PI / 180.0f;
+    mt19937 gen(42);
+    uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    uniform_real_distribution<float> angle(0.0f, 360.0f);
+    uniform_real_distribution<float> speed(30.0f, 180.0f);  // degrees per second
+
+    Particles &p = particles;
+    p.count = count;
+    p.c.resize(count);
+    p.s.resize(count);
+    p.stepC.resize(count);
+    p.stepS.resize(count);
+    p.dir.resize(count);
+    p.px.resize(count);
+    p.py.resize(count);
+    p.vx.resize(count);
+    p.vy.resize(count);
+    p.vertices.clear();
+
+    for (int i = 0; i < count; i++) {
+        float a = angle(gen) * RAD;
+        float w = speed(gen) * SIM_STEP * RAD;
+        p.c[i] = cos(a);
+        p.s[i] = sin(a);
+        p.stepC[i] = cos(w);
+        p.stepS[i] = sin(w);
+        p.dir[i] = unit(gen) < 0.0f ? -1.0f : 1.0f;
+        p.px[i] = unit(gen);
+        p.py[i] = unit(gen);
+        p.vx[i] = 0.25f * SIM_STEP * unit(gen);
+        p.vy[i] = 0.25f * SIM_STEP * unit(gen);
+    }
+}
+
+void updateParticles(int begin, int end) {
+    float *__restrict c = &particles.c[0];
+    float *__restrict s = &particles.s[0];
+    const float *__restrict stepC = &particles.stepC[0];
+    const float *__restrict stepS = &particles.stepS[0];
+    const float *__restrict dir = &particles.dir[0];
+    float *__restrict px = &particles.px[0];
+    float *__restrict py = &particles.py[0];
+    float *__restrict vx = &particles.vx[0];
+    float *__restrict vy = &particles.vy[0];
+
+    // Branch-free so the compiler can vectorize it
+    for (int i = begin; i < end; i++) {
+        float ds = dir[i] * stepS[i];
+        float nc = c[i] * stepC[i] - s[i] * ds;
+        float ns = c[i] * ds + s[i] * stepC[i];
+        // One Newton step back to unit length against rounding drift
+        float k = 1.5f - 0.5f * (nc * nc + ns * ns);
+        c[i] = nc * k;
+        s[i] = ns * k;
+
+        float x = px[i] + vx[i];
+        float y = py[i] + vy[i];
+        vx[i] = (x > 1.0f || x < -1.0f) ? -vx[i] : vx[i];
+        vy[i] = (y > 1.0f || y < -1.0f) ? -vy[i] : vy[i];
+        px[i] = x;
+        py[i] = y;
+    }
+}
+
+void expandParticles(int begin, int end) {
+    int segments = (int)(particles.shape->size() / 2);
+    const float *__restrict u = &(*particles.shape)[0];
+    float *__restrict out = &particles.vertices[0];
+    const float ax = 0.2f * PARTICLE_SCALE;
+    const float ay = 0.4f * PARTICLE_SCALE;
+
+    for (int i = begin; i < end; i++) {
+        float c = particles.c[i], s = particles.s[i];
+        float tx = particles.px[i], ty = particles.py[i];
+        float *__restrict v = out + (size_t)i * segments * 4;
+        // Same transform as the single ellipse: rotate by -theta, then translate
+        for (int k = 0; k < segments; k++) {
+            int k1 = (k + 1 == segments) ? 0 : k + 1;
+            float x0 = ax * u[2 * k], y0 = ay * u[2 * k + 1];
+            float x1 = ax * u[2 * k1], y1 = ay * u[2 * k1 + 1];
+            v[4 * k] = x0 * c + y0 * s + tx;
+            v[4 * k + 1] = -x0 * s + y0 * c + ty;
+            v[4 * k + 2] = x1 * c + y1 * s + tx;
+            v[4 * k + 3] = -x1 * s + y1 * c + ty;
+        }
+    }
+}
+
+void parallelFor(int count, void (*kernel)(int, int)) {
+    int n = (int)min<unsigned int>(workerCount, (unsigned int)(count / 4096 + 1));
+    if (n <= 1) {
+        kernel(0, count);
+        return;
+    }
+
+    int chunk = (count + n - 1) / n;
+    workers.run(n, [=](int w) {
+        int begin = w * chunk;
+        int end = min(count, begin + chunk);
+        if (begin < end) kernel(begin, end);
+    });
+}
+
+void benchParticles(int count) {
+    const int FRAMES = 60;
+
+    initParticles(count);
+    const vector<float> &shape = tessellator.unitCircle(PARTICLE_SCALE * 0.4f * 250.0f, TOLERANCE_PX);
+    particles.vertices.resize((size_t)count * shape.size() * 2);
+    particles.shape = &shape;
+
+    clock_type::time_point t0 = clock_type::now();
+    for (int f = 0; f < FRAMES; f++) parallelFor(count, updateParticles);
+    clock_type::time_point t1 = clock_type::now();
+
+    for (int f = 0; f < FRAMES; f++) parallelFor(count, expandParticles);
+    clock_type::time_point t2 = clock_type::now();
+
+    double updateMs = chrono::duration<double, milli>(t1 - t0).count() / FRAMES;
+    double expandMs = chrono::duration<double, milli>(t2 - t1).count() / FRAMES;
+    cout << count << " ellipses, " << shape.size() / 2 << " segments each, " << workerCount << " threads" << endl;
+    cout << "update: " << updateMs << " ms/frame (" << count / updateMs / 1000.0 << " M ellipses/s)" << endl;
+    cout << "expand: " << expandMs << " ms/frame (" << count * (shape.size() / 2) / expandMs / 1000.0
+         << " M segments/s)" << endl;
 }
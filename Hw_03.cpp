@@ -1,9 +1,22 @@
-#include <windows.h>
-
+#include <chrono>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
 
 #include "glut.h"
+#else
+#include <GL/glut.h>
+#endif
+
+#include "profiler.h"
 using namespace std;
 
 float theta = 0.0f;  
@@ -11,6 +24,70 @@ float x = 0.0f;
 float y = 0.0f;      
 float h = 0.2f;      
 float l = 0.2f;      
+bool showProfile = false;
+
+// Arm geometry, taken from the transform chain in display()
+const float BASE_OFFSET = 0.2f;   // base cube centre relative to (x, y)
+const float ARM_REACH = 0.8f;     // horizontal arm length from the column axis to the gripper
+const float GRIP_DROP = 0.4f;     // finger centre sits at y + GRIP_DROP - h
+const float H_MIN = 0.1f;         // clamps used by GripperHeight()
+const float H_MAX = 0.6f;
+const float BASE_LIMIT = 2.0f;    // base travel, same extent as the drawn axes
+
+struct ArmPose {
+    float x, y, theta, h;
+};
+
+// Reachability voxel grid over [-REACH_EXTENT, REACH_EXTENT]^3
+const int REACH_RES = 64;
+const float REACH_EXTENT = 3.0f;
+vector<unsigned char> reachGrid;
+
+struct Keyframe {
+    ArmPose pose;
+    float l;
+    float duration;  // seconds to reach this keyframe from the previous one
+};
+
+const float SIM_STEP = 1.0f / 120.0f;
+const float STEP_DURATION = 0.25f;
+deque<Keyframe> trajectory;
+Keyframe segmentStart;
+float segmentTime = 0.0f;
+float accumulator = 0.0f;
+int lastTick = 0;
+
+// Oriented box: centre, local axes (rows) and half extents
+struct OBB {
+    float c[3];
+    float u[3][3];
+    float e[3];
+};
+
+struct PickBox {
+    OBB box;
+    float yaw;
+    bool hit;
+};
+
+// Uniform grid over the floor (XZ plane) in compressed cell lists
+struct FloorGrid {
+    float cell;
+    float minX, minZ;
+    int nx, nz;
+    vector<int> cellStart;  // nx * nz + 1 offsets into items, cell c is [cellStart[c], cellStart[c + 1])
+    vector<int> items;
+    vector<unsigned int> stamp;
+    unsigned int query;
+};
+
+const float FLOOR_Y = -0.6f;
+const int ARM_PARTS = 8;
+vector<PickBox> boxes;
+FloorGrid floorGrid;
+int heldBox = -1;
+float heldWidth = 0.0f;
+float heldYaw = 0.0f;
 
 //--------------------------------------------------------------------//
 void idle();
@@ -22,7 +99,35 @@ void myMenu(int id);
 void reshape(int w, int h);
 void keyboard(unsigned char key, GLint x, GLint y);
 
+Keyframe queuedKeyframe();
+void pushKeyframe(const Keyframe &k);
+void stepTrajectory(float dt);
+
+bool solveIK(float tx, float ty, float tz, const ArmPose &current, ArmPose &out);
+int solveIKBatch(const float *targets, int count, const ArmPose &current, ArmPose *out, unsigned char *ok);
+void buildReachGrid();
+bool isReachable(float px, float py, float pz);
+void benchIK();
+
+void makeOBB(OBB &b, float cx, float cy, float cz, float yaw, float ex, float ey, float ez);
+void computeArmParts(const ArmPose &pose, float grip, OBB parts[ARM_PARTS]);
+bool overlapOBB(const OBB &a, const OBB &b);
+void buildFloorGrid(FloorGrid &grid, const vector<PickBox> &scene, int skip);
+int queryFloorGrid(FloorGrid &grid, const vector<PickBox> &scene, const OBB &part, int *hits, int maxHits);
+void scatterBoxes(vector<PickBox> &scene, int count, float side, unsigned int seed);
+void updateGrasp();
+void benchCollision();
+
 int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "--bench-ik") == 0) {
+        benchIK();
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-collision") == 0) {
+        benchCollision();
+        return 0;
+    }
+
     // 初始化 GLUT
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
@@ -31,11 +136,13 @@ int main(int argc, char **argv) {
     glutCreateWindow("HW_03");
 
     glutDisplayFunc(display);
-    glutIdleFunc(idle);
     glutKeyboardFunc(keyboard);
     glutReshapeFunc(reshape);
 
     init();
+    buildReachGrid();
+    scatterBoxes(boxes, 12, 3.0f, 2024);
+    buildFloorGrid(floorGrid, boxes, -1);
     glutMainLoop();
     return 0;
 }
@@ -50,58 +157,559 @@ void myMenu(int id) {
 }
 
 void Xdirection(int id) {
+    Keyframe k = queuedKeyframe();
     switch (id) {
         case 1:
-            x += 0.1f;
+            k.pose.x += 0.1f;
             break;
         case 2:
-            x -= 0.1f;
+            k.pose.x -= 0.1f;
             break;
     }
+    pushKeyframe(k);
 }
 
 void Ydirection(int id) {
+    Keyframe k = queuedKeyframe();
     switch (id) {
         case 3:
-            y += 0.1f;
+            k.pose.y += 0.1f;
             break;
         case 4:
-            y -= 0.1f;
+            k.pose.y -= 0.1f;
             break;
     }
+    pushKeyframe(k);
 }
 
 void ArmRotation(int id) {
+    Keyframe k = queuedKeyframe();
     switch (id) {
         case 5:
-            theta += 5.0f;
+            k.pose.theta += 5.0f;
             break;
         case 6:
-            theta -= 5.0f;
+            k.pose.theta -= 5.0f;
             break;
     }
+    pushKeyframe(k);
 }
 
 void GripperHeight(int id) {
+    Keyframe k = queuedKeyframe();
     switch (id) {
         case 7:
-            h = max(0.1f, h - 0.05f);
+            k.pose.h = max(H_MIN, k.pose.h - 0.05f);
             break;  
         case 8:
-            h = min(h + 0.05f, 0.6f);
+            k.pose.h = min(k.pose.h + 0.05f, H_MAX);
             break;
     }
+    pushKeyframe(k);
 }
 
 void GripperControl(int id) {
+    Keyframe k = queuedKeyframe();
     switch (id) {
         case 9:
-            l = min(l + 0.05f, 0.4f);
+            k.l = min(k.l + 0.05f, 0.4f);
             break;
         case 10:
-            l = max(0.1f, l - 0.05f);
+            k.l = max(0.1f, k.l - 0.05f);
             break;
     }
+    pushKeyframe(k);
+}
+
+void ReachTarget(int id) {
+    // Preset targets for the finger centre
+    static const float targets[][3] = {
+        {1.0f, 0.0f, 0.0f},
+        {0.2f, 0.2f, -0.6f},
+        {0.2f, -0.2f, 0.6f},
+        {-0.6f, 0.4f, 0.0f},
+    };
+    if (id < 12 || id > 15) return;
+
+    const float *t = targets[id - 12];
+    Keyframe k = queuedKeyframe();
+    ArmPose pose;
+    if (solveIK(t[0], t[1], t[2], k.pose, pose)) {
+        k.pose = pose;
+        // Long moves get proportionally more time
+        k.duration = 0.3f + 0.01f * fabs(pose.theta - queuedKeyframe().pose.theta);
+        pushKeyframe(k);
+    } else {
+        cout << "Target (" << t[0] << ", " << t[1] << ", " << t[2] << ") is out of reach" << endl;
+    }
+}
+
+//--------------------------------------------------------------------//
+// Trajectory buffer: menu commands queue keyframes, idle() plays them back
+Keyframe queuedKeyframe() {
+    Keyframe k;
+    if (trajectory.empty()) {
+        k.pose.x = x;
+        k.pose.y = y;
+        k.pose.theta = theta;
+        k.pose.h = h;
+        k.l = l;
+    } else {
+        k = trajectory.back();
+    }
+    k.duration = STEP_DURATION;
+    return k;
+}
+
+void pushKeyframe(const Keyframe &k) {
+    if (trajectory.empty()) {
+        segmentStart = queuedKeyframe();
+        segmentTime = 0.0f;
+        accumulator = 0.0f;
+        lastTick = glutGet(GLUT_ELAPSED_TIME);
+        glutIdleFunc(idle);
+    }
+    trajectory.push_back(k);
+}
+
+void stepTrajectory(float dt) {
+    if (trajectory.empty()) return;
+
+    const Keyframe &target = trajectory.front();
+    segmentTime += dt;
+    float t = target.duration > 0.0f ? min(segmentTime / target.duration, 1.0f) : 1.0f;
+    float s = t * t * (3.0f - 2.0f * t);  // ease in/out
+
+    x = segmentStart.pose.x + (target.pose.x - segmentStart.pose.x) * s;
+    y = segmentStart.pose.y + (target.pose.y - segmentStart.pose.y) * s;
+    theta = segmentStart.pose.theta + (target.pose.theta - segmentStart.pose.theta) * s;
+    h = segmentStart.pose.h + (target.pose.h - segmentStart.pose.h) * s;
+    l = segmentStart.l + (target.l - segmentStart.l) * s;
+
+    updateGrasp();
+
+    if (t >= 1.0f) {
+        segmentStart = target;
+        segmentTime = 0.0f;
+        trajectory.pop_front();
+    }
+}
+
+//--------------------------------------------------------------------//
+// Inverse kinematics: the finger centre is at
+//   (x + BASE_OFFSET + ARM_REACH * cos(theta), y + GRIP_DROP - h, -ARM_REACH * sin(theta))
+bool solveIK(float tx, float ty, float tz, const ArmPose &current, ArmPose &out) {
+    const float RAD = 3.14159265f / 180.0f;
+
+    // Rotation: the arm only reaches sideways through theta
+    float s = -tz / ARM_REACH;
+    if (s < -1.0f || s > 1.0f) return false;
+
+    float a = asin(s) / RAD;
+    float candidates[2] = {a, 180.0f - a};
+    bool found = false;
+    float bestCost = 0.0f;
+    for (int i = 0; i < 2; i++) {
+        float t = candidates[i];
+        // Unwrap to the turn closest to the current angle
+        t += 360.0f * floor((current.theta - t) / 360.0f + 0.5f);
+        float bx = tx - BASE_OFFSET - ARM_REACH * cos(t * RAD);
+        if (bx < -BASE_LIMIT || bx > BASE_LIMIT) continue;
+
+        float cost = fabs(t - current.theta) + fabs(bx - current.x);
+        if (!found || cost < bestCost) {
+            found = true;
+            bestCost = cost;
+            out.theta = t;
+            out.x = bx;
+        }
+    }
+    if (!found) return false;
+
+    // Height: prefer moving the gripper and keep the base where it is. The
+    // base ends up at y = ty - GRIP_DROP + h, which must stay in BASE_LIMIT.
+    float lo = max(H_MIN, GRIP_DROP - ty - BASE_LIMIT);
+    float hi = min(H_MAX, GRIP_DROP - ty + BASE_LIMIT);
+    if (lo > hi) return false;
+
+    out.h = min(max(current.y + GRIP_DROP - ty, lo), hi);
+    out.y = ty - GRIP_DROP + out.h;
+    return true;
+}
+
+int solveIKBatch(const float *targets, int count, const ArmPose &current, ArmPose *out, unsigned char *ok) {
+    int solved = 0;
+    for (int i = 0; i < count; i++) {
+        ok[i] = solveIK(targets[3 * i], targets[3 * i + 1], targets[3 * i + 2], current, out[i]);
+        solved += ok[i];
+    }
+    return solved;
+}
+
+void buildReachGrid() {
+    reachGrid.assign(REACH_RES * REACH_RES * REACH_RES, 0);
+
+    unsigned int workers = max(1u, thread::hardware_concurrency());
+    vector<thread> pool;
+    for (unsigned int w = 0; w < workers; w++) {
+        pool.push_back(thread([w, workers]() {
+            ArmPose rest = {0.0f, 0.0f, 0.0f, 0.2f};
+            ArmPose pose;
+            float step = 2.0f * REACH_EXTENT / REACH_RES;
+            // Each worker owns every workers-th z slab
+            for (int k = w; k < REACH_RES; k += workers) {
+                float pz = -REACH_EXTENT + (k + 0.5f) * step;
+                for (int j = 0; j < REACH_RES; j++) {
+                    float py = -REACH_EXTENT + (j + 0.5f) * step;
+                    for (int i = 0; i < REACH_RES; i++) {
+                        float px = -REACH_EXTENT + (i + 0.5f) * step;
+                        reachGrid[(k * REACH_RES + j) * REACH_RES + i] = solveIK(px, py, pz, rest, pose);
+                    }
+                }
+            }
+        }));
+    }
+    for (size_t i = 0; i < pool.size(); i++) pool[i].join();
+}
+
+bool isReachable(float px, float py, float pz) {
+    float scale = REACH_RES / (2.0f * REACH_EXTENT);
+    int i = (int)floor((px + REACH_EXTENT) * scale);
+    int j = (int)floor((py + REACH_EXTENT) * scale);
+    int k = (int)floor((pz + REACH_EXTENT) * scale);
+    if (i < 0 || j < 0 || k < 0 || i >= REACH_RES || j >= REACH_RES || k >= REACH_RES) return false;
+    return reachGrid[(k * REACH_RES + j) * REACH_RES + i] != 0;
+}
+
+void benchIK() {
+    typedef chrono::steady_clock clock_type;
+    const int COUNT = 1000000;
+
+    mt19937 gen(12345);
+    uniform_real_distribution<float> dist(-REACH_EXTENT, REACH_EXTENT);
+    vector<float> targets(3 * COUNT);
+    for (size_t i = 0; i < targets.size(); i++) targets[i] = dist(gen);
+
+    vector<ArmPose> poses(COUNT);
+    vector<unsigned char> ok(COUNT);
+    ArmPose current = {x, y, theta, h};
+
+    clock_type::time_point t0 = clock_type::now();
+    int solved = solveIKBatch(&targets[0], COUNT, current, &poses[0], &ok[0]);
+    clock_type::time_point t1 = clock_type::now();
+
+    // Every solution must keep the base in range and put the finger on the
+    // target; checked in release builds too, where assert() is compiled out
+    const float RAD = 3.14159265f / 180.0f;
+    int bad = 0;
+    for (int i = 0; i < COUNT; i++) {
+        if (!ok[i]) continue;
+        const ArmPose &p = poses[i];
+        const float *t = &targets[3 * i];
+        bool inRange = fabs(p.x) <= BASE_LIMIT + 1e-4f && fabs(p.y) <= BASE_LIMIT + 1e-4f && p.h >= H_MIN &&
+                       p.h <= H_MAX;
+        bool onTarget = fabs(p.x + BASE_OFFSET + ARM_REACH * cos(p.theta * RAD) - t[0]) < 1e-3f &&
+                        fabs(p.y + GRIP_DROP - p.h - t[1]) < 1e-3f &&
+                        fabs(-ARM_REACH * sin(p.theta * RAD) - t[2]) < 1e-3f;
+        bad += !(inRange && onTarget);
+    }
+    if (bad) {
+        cerr << "IK check: " << bad << " solutions out of range or off target" << endl;
+        exit(1);
+    }
+    buildReachGrid();
+    clock_type::time_point t2 = clock_type::now();
+    int reachable = 0;
+    for (int i = 0; i < COUNT; i++) {
+        reachable += isReachable(targets[3 * i], targets[3 * i + 1], targets[3 * i + 2]);
+    }
+    clock_type::time_point t3 = clock_type::now();
+
+    double solveMs = chrono::duration<double, milli>(t1 - t0).count();
+    double gridMs = chrono::duration<double, milli>(t2 - t1).count();
+    double lookupMs = chrono::duration<double, milli>(t3 - t2).count();
+    cout << "IK batch:     " << COUNT << " targets, " << solved << " solved, " << solveMs << " ms ("
+         << COUNT / solveMs / 1000.0 << " M solves/s)" << endl;
+    cout << "Reach grid:   " << REACH_RES << "^3 voxels built in " << gridMs << " ms on "
+         << max(1u, thread::hardware_concurrency()) << " threads" << endl;
+    cout << "Grid lookups: " << reachable << " reachable, " << lookupMs << " ms ("
+         << COUNT / lookupMs / 1000.0 << " M lookups/s)" << endl;
+}
+
+//--------------------------------------------------------------------//
+// Collision detection between the arm and the boxes on the floor
+void makeOBB(OBB &b, float cx, float cy, float cz, float yaw, float ex, float ey, float ez) {
+    const float RAD = 3.14159265f / 180.0f;
+    float c = cos(yaw * RAD);
+    float s = sin(yaw * RAD);
+
+    // Same orientation as glRotatef(yaw, 0, 1, 0)
+    b.c[0] = cx; b.c[1] = cy; b.c[2] = cz;
+    b.u[0][0] = c;    b.u[0][1] = 0.0f; b.u[0][2] = -s;
+    b.u[1][0] = 0.0f; b.u[1][1] = 1.0f; b.u[1][2] = 0.0f;
+    b.u[2][0] = s;    b.u[2][1] = 0.0f; b.u[2][2] = c;
+    b.e[0] = ex; b.e[1] = ey; b.e[2] = ez;
+}
+
+// Mirrors the transform chain in display()
+void computeArmParts(const ArmPose &pose, float grip, OBB parts[ARM_PARTS]) {
+    const float RAD = 3.14159265f / 180.0f;
+    float c = cos(pose.theta * RAD);
+    float s = sin(pose.theta * RAD);
+    float bx = pose.x + BASE_OFFSET;
+    float by = pose.y + BASE_OFFSET;
+
+    // Offsets along the arm, relative to the column centre
+    const float along[ARM_PARTS] = {0.0f, 0.0f, 0.5f, 0.8f, 0.8f, 0.8f, 0.8f + grip / 2.0f, 0.8f - grip / 2.0f};
+    const float up[ARM_PARTS] = {-0.5f, 0.0f, 0.2f, 0.0f, -(0.1f + pose.h / 2.0f), -(0.15f + pose.h),
+                                 -(0.3f + pose.h), -(0.3f + pose.h)};
+    const float half[ARM_PARTS][3] = {
+        {0.2f, 0.2f, 0.2f},   {0.1f, 0.3f, 0.1f},  {0.4f, 0.1f, 0.1f},  {0.1f, 0.1f, 0.1f},
+        {0.05f, pose.h / 2.0f, 0.05f}, {0.3f, 0.05f, 0.05f}, {0.05f, 0.1f, 0.05f}, {0.05f, 0.1f, 0.05f},
+    };
+
+    makeOBB(parts[0], bx, by, 0.0f, 0.0f, half[0][0], half[0][1], half[0][2]);
+    for (int i = 1; i < ARM_PARTS; i++) {
+        makeOBB(parts[i], bx + along[i] * c, by + 0.5f + up[i], -along[i] * s, pose.theta, half[i][0], half[i][1],
+                half[i][2]);
+    }
+}
+
+// Separating axis test, 15 candidate axes
+bool overlapOBB(const OBB &a, const OBB &b) {
+    const float EPS = 1e-6f;
+    float R[3][3], AbsR[3][3], t[3], d[3];
+
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            R[i][j] = a.u[i][0] * b.u[j][0] + a.u[i][1] * b.u[j][1] + a.u[i][2] * b.u[j][2];
+            AbsR[i][j] = fabs(R[i][j]) + EPS;
+        }
+    }
+    for (int i = 0; i < 3; i++) d[i] = b.c[i] - a.c[i];
+    for (int i = 0; i < 3; i++) t[i] = d[0] * a.u[i][0] + d[1] * a.u[i][1] + d[2] * a.u[i][2];
+
+    float ra, rb;
+    for (int i = 0; i < 3; i++) {
+        ra = a.e[i];
+        rb = b.e[0] * AbsR[i][0] + b.e[1] * AbsR[i][1] + b.e[2] * AbsR[i][2];
+        if (fabs(t[i]) > ra + rb) return false;
+    }
+    for (int j = 0; j < 3; j++) {
+        ra = a.e[0] * AbsR[0][j] + a.e[1] * AbsR[1][j] + a.e[2] * AbsR[2][j];
+        rb = b.e[j];
+        if (fabs(t[0] * R[0][j] + t[1] * R[1][j] + t[2] * R[2][j]) > ra + rb) return false;
+    }
+    for (int i = 0; i < 3; i++) {
+        int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+        for (int j = 0; j < 3; j++) {
+            int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+            ra = a.e[i1] * AbsR[i2][j] + a.e[i2] * AbsR[i1][j];
+            rb = b.e[j1] * AbsR[i][j2] + b.e[j2] * AbsR[i][j1];
+            if (fabs(t[i2] * R[i1][j] - t[i1] * R[i2][j]) > ra + rb) return false;
+        }
+    }
+    return true;
+}
+
+// Half extent of an OBB's bounding box along world axis k
+static float aabbHalf(const OBB &b, int k) {
+    return fabs(b.u[0][k]) * b.e[0] + fabs(b.u[1][k]) * b.e[1] + fabs(b.u[2][k]) * b.e[2];
+}
+
+void buildFloorGrid(FloorGrid &grid, const vector<PickBox> &scene, int skip) {
+    grid.cell = 0.5f;
+    grid.query = 0;
+    grid.stamp.assign(scene.size(), 0);
+
+    float maxX = 0.0f, maxZ = 0.0f;
+    grid.minX = grid.minZ = 0.0f;
+    for (size_t i = 0; i < scene.size(); i++) {
+        const OBB &b = scene[i].box;
+        grid.minX = min(grid.minX, b.c[0] - aabbHalf(b, 0));
+        grid.minZ = min(grid.minZ, b.c[2] - aabbHalf(b, 2));
+        maxX = max(maxX, b.c[0] + aabbHalf(b, 0));
+        maxZ = max(maxZ, b.c[2] + aabbHalf(b, 2));
+    }
+    grid.nx = (int)((maxX - grid.minX) / grid.cell) + 1;
+    grid.nz = (int)((maxZ - grid.minZ) / grid.cell) + 1;
+    grid.cellStart.assign(grid.nx * grid.nz + 1, 0);
+
+    // Two passes: count entries per cell, then fill
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1) {
+            for (size_t i = 1; i < grid.cellStart.size(); i++) grid.cellStart[i] += grid.cellStart[i - 1];
+            grid.items.resize(grid.cellStart.back());
+        }
+        for (size_t i = 0; i < scene.size(); i++) {
+            if ((int)i == skip) continue;
+            const OBB &b = scene[i].box;
+            int x0 = (int)((b.c[0] - aabbHalf(b, 0) - grid.minX) / grid.cell);
+            int x1 = (int)((b.c[0] + aabbHalf(b, 0) - grid.minX) / grid.cell);
+            int z0 = (int)((b.c[2] - aabbHalf(b, 2) - grid.minZ) / grid.cell);
+            int z1 = (int)((b.c[2] + aabbHalf(b, 2) - grid.minZ) / grid.cell);
+            for (int gz = z0; gz <= z1; gz++) {
+                for (int gx = x0; gx <= x1; gx++) {
+                    int cell = gz * grid.nx + gx;
+                    if (pass == 0) {
+                        grid.cellStart[cell]++;
+                    } else {
+                        grid.items[--grid.cellStart[cell]] = (int)i;
+                    }
+                }
+            }
+        }
+    }
+}
+
+int queryFloorGrid(FloorGrid &grid, const vector<PickBox> &scene, const OBB &part, int *hits, int maxHits) {
+    int x0 = max(0, (int)floor((part.c[0] - aabbHalf(part, 0) - grid.minX) / grid.cell));
+    int x1 = min(grid.nx - 1, (int)floor((part.c[0] + aabbHalf(part, 0) - grid.minX) / grid.cell));
+    int z0 = max(0, (int)floor((part.c[2] - aabbHalf(part, 2) - grid.minZ) / grid.cell));
+    int z1 = min(grid.nz - 1, (int)floor((part.c[2] + aabbHalf(part, 2) - grid.minZ) / grid.cell));
+    float y0 = part.c[1] - aabbHalf(part, 1);
+    float y1 = part.c[1] + aabbHalf(part, 1);
+
+    // A box spanning several cells is only tested once per query
+    grid.query++;
+    int count = 0;
+    for (int gz = z0; gz <= z1; gz++) {
+        for (int gx = x0; gx <= x1; gx++) {
+            int cell = gz * grid.nx + gx;
+            for (int k = grid.cellStart[cell]; k < grid.cellStart[cell + 1]; k++) {
+                int i = grid.items[k];
+                if (grid.stamp[i] == grid.query) continue;
+                grid.stamp[i] = grid.query;
+
+                const OBB &b = scene[i].box;
+                if (b.c[1] - aabbHalf(b, 1) > y1 || b.c[1] + aabbHalf(b, 1) < y0) continue;
+                if (overlapOBB(part, b) && count < maxHits) hits[count++] = i;
+            }
+        }
+    }
+    return count;
+}
+
+void scatterBoxes(vector<PickBox> &scene, int count, float side, unsigned int seed) {
+    mt19937 gen(seed);
+    uniform_real_distribution<float> pos(-side / 2.0f, side / 2.0f);
+    uniform_real_distribution<float> yaw(0.0f, 90.0f);
+    uniform_real_distribution<float> size(0.05f, 0.1f);
+
+    scene.resize(count);
+    for (int i = 0; i < count; i++) {
+        float e = size(gen);
+        float cx = BASE_OFFSET + pos(gen);
+        float cz = pos(gen);
+        scene[i].yaw = yaw(gen);
+        scene[i].hit = false;
+        makeOBB(scene[i].box, cx, FLOOR_Y + e, cz, scene[i].yaw, e, e, e);
+    }
+}
+
+// Grab a box squeezed by both fingers, release it when the gripper opens
+void updateGrasp() {
+    ArmPose pose = {x, y, theta, h};
+    OBB parts[ARM_PARTS];
+    computeArmParts(pose, l, parts);
+
+    if (heldBox >= 0) {
+        if (l > heldWidth + 0.01f) {
+            PickBox &b = boxes[heldBox];
+            makeOBB(b.box, b.box.c[0], FLOOR_Y + b.box.e[1], b.box.c[2], b.yaw, b.box.e[0], b.box.e[1], b.box.e[2]);
+            heldBox = -1;
+            buildFloorGrid(floorGrid, boxes, -1);
+        } else {
+            // Fingers cannot close through the box
+            l = heldWidth;
+            computeArmParts(pose, l, parts);
+            PickBox &b = boxes[heldBox];
+            b.yaw = heldYaw + theta;
+            float cx = (parts[6].c[0] + parts[7].c[0]) / 2.0f;
+            float cy = (parts[6].c[1] + parts[7].c[1]) / 2.0f;
+            float cz = (parts[6].c[2] + parts[7].c[2]) / 2.0f;
+            makeOBB(b.box, cx, cy, cz, b.yaw, b.box.e[0], b.box.e[1], b.box.e[2]);
+        }
+    }
+
+    for (size_t i = 0; i < boxes.size(); i++) boxes[i].hit = false;
+
+    int hits[ARM_PARTS][16];
+    int counts[ARM_PARTS];
+    for (int p = 0; p < ARM_PARTS; p++) {
+        counts[p] = queryFloorGrid(floorGrid, boxes, parts[p], hits[p], 16);
+        for (int k = 0; k < counts[p]; k++) boxes[hits[p][k]].hit = true;
+    }
+
+    if (heldBox >= 0) return;
+    for (int a = 0; a < counts[6]; a++) {
+        for (int b = 0; b < counts[7]; b++) {
+            if (hits[6][a] == hits[7][b]) {
+                heldBox = hits[6][a];
+                heldWidth = l;
+                heldYaw = boxes[heldBox].yaw - theta;
+                buildFloorGrid(floorGrid, boxes, heldBox);
+                return;
+            }
+        }
+    }
+}
+
+void benchCollision() {
+    typedef chrono::steady_clock clock_type;
+    const int QUERIES = 20000;
+    const int counts[] = {1000, 10000, 100000};
+
+    cout << "objects  build_ms  grid_ns/query  brute_ns/query  avg_hits  brute_avg_hits" << endl;
+    for (int c = 0; c < 3; c++) {
+        int n = counts[c];
+        // Keep density constant so the floor grows with the object count
+        float side = sqrt((float)n) * 0.6f;
+        vector<PickBox> scene;
+        scatterBoxes(scene, n, side, 7);
+
+        FloorGrid grid;
+        clock_type::time_point t0 = clock_type::now();
+        buildFloorGrid(grid, scene, -1);
+        clock_type::time_point t1 = clock_type::now();
+
+        mt19937 gen(99);
+        uniform_real_distribution<float> pos(-side / 2.0f, side / 2.0f);
+        uniform_real_distribution<float> ang(0.0f, 360.0f);
+        uniform_real_distribution<float> hh(H_MIN, H_MAX);
+        vector<ArmPose> poses(QUERIES);
+        for (int q = 0; q < QUERIES; q++) {
+            poses[q].x = pos(gen);
+            poses[q].h = hh(gen);
+            poses[q].y = FLOOR_Y + poses[q].h - 0.3f;  // fingers at floor level
+            poses[q].theta = ang(gen);
+        }
+
+        long long hitTotal = 0;
+        int hits[16];
+        OBB parts[ARM_PARTS];
+        for (int q = 0; q < QUERIES; q++) {
+            computeArmParts(poses[q], 0.2f, parts);
+            for (int p = 0; p < ARM_PARTS; p++) hitTotal += queryFloorGrid(grid, scene, parts[p], hits, 16);
+        }
+        clock_type::time_point t2 = clock_type::now();
+
+        // Brute force over every object, fewer queries for the large scenes
+        int bruteQueries = max(10, QUERIES / (n / 100));
+        long long bruteTotal = 0;
+        for (int q = 0; q < bruteQueries; q++) {
+            computeArmParts(poses[q], 0.2f, parts);
+            for (int p = 0; p < ARM_PARTS; p++) {
+                for (int i = 0; i < n; i++) bruteTotal += overlapOBB(parts[p], scene[i].box);
+            }
+        }
+        clock_type::time_point t3 = clock_type::now();
+
+        cout << n << "  " << chrono::duration<double, milli>(t1 - t0).count() << "  "
+             << chrono::duration<double, nano>(t2 - t1).count() / QUERIES << "  "
+             << chrono::duration<double, nano>(t3 - t2).count() / bruteQueries << "  "
+             << (double)hitTotal / QUERIES << "  " << (double)bruteTotal / bruteQueries << endl;
+    }
 }
 
 void init() {
@@ -131,12 +739,19 @@ void init() {
     glutAddMenuEntry("Open", 9);
     glutAddMenuEntry("Close", 10);
 
+    int _ReachTarget = glutCreateMenu(ReachTarget);
+    glutAddMenuEntry("Front", 12);
+    glutAddMenuEntry("Back Left", 13);
+    glutAddMenuEntry("Front Right", 14);
+    glutAddMenuEntry("Behind", 15);
+
     glutCreateMenu(myMenu);
     glutAddSubMenu("X direction", _Xdirection);
     glutAddSubMenu("Y direction", _Ydirection);
     glutAddSubMenu("Arm Roattion", _ArmRotation);
     glutAddSubMenu("Gripper Height", _GripperHeight);
     glutAddSubMenu("Gripper Control", _GripperControl);
+    glutAddSubMenu("Reach Target", _ReachTarget);
 
     glutAddMenuEntry("Exit", 11);
     glutAttachMenu(GLUT_RIGHT_BUTTON);
@@ -155,10 +770,24 @@ void reshape(int w, int h) {
 }
 
 void idle() {
+    int now = glutGet(GLUT_ELAPSED_TIME);
+    accumulator += (now - lastTick) / 1000.0f;
+    lastTick = now;
+
+    // Fixed simulation step, independent of the redraw rate
+    while (accumulator >= SIM_STEP && !trajectory.empty()) {
+        stepTrajectory(SIM_STEP);
+        accumulator -= SIM_STEP;
+    }
+
+    // Nothing left to animate: stop polling until the next command
+    if (trajectory.empty()) glutIdleFunc(NULL);
     glutPostRedisplay();
 }
 
 void display() {
+    profiler().beginFrame();
+    PROFILE_SCOPE("display");
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     glLoadIdentity();
@@ -183,6 +812,7 @@ void display() {
     glVertex3f(0.0, 0.0, 2.0);
     glEnd();
 
+    glPushMatrix();
     glTranslatef(x, y, 0.0f);
 
     glTranslatef(0.2f, 0.2f, 0.0f);
@@ -235,14 +865,39 @@ void display() {
     draw_cube();
     glPopMatrix();
 
+    glPopMatrix();
+
+    for (size_t i = 0; i < boxes.size(); i++) {
+        const OBB &b = boxes[i].box;
+        glPushMatrix();
+        glTranslatef(b.c[0], b.c[1], b.c[2]);
+        glRotatef(boxes[i].yaw, 0.0f, 1.0f, 0.0f);
+        glScalef(2.0f * b.e[0], 2.0f * b.e[1], 2.0f * b.e[2]);
+        draw_cube();
+        if (boxes[i].hit) {
+            glColor3f(1.0f, 1.0f, 1.0f);
+            glutWireCube(1.02f);
+        }
+        glPopMatrix();
+    }
+
+    if (showProfile) profiler().drawOverlay(glutGet(GLUT_WINDOW_HEIGHT));
     glutSwapBuffers();
 }
 
 void keyboard(unsigned char key, GLint x, GLint y) {
     if (key == 'q' || key == 'Q') exit(0);
+    if (key == 'p' || key == 'P') {
+        showProfile = !showProfile;
+        glutPostRedisplay();
+    }
+    if (key == 't' || key == 'T') {
+        if (profiler().writeChromeTrace("Hw_03_trace.json")) cout << "Wrote Hw_03_trace.json" << endl;
+    }
 }
 
 void draw_cube() {
+    PROFILE_SCOPE("draw_cube");
     glBegin(GL_QUADS);
     glColor3f(1, 0, 0);
     glVertex3f(-0.5f, -0.5f, 0.5f);
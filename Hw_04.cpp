@@ -1,14 +1,43 @@
-#include <windows.h>
+#include <stdint.h>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <iostream>
 #include <random>
-#include <stack>
+#include <thread>
 #include <vector>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "arena.h"
+#include "maze_core.h"
+#include "maze_net.h"  // ahead of windows.h for winsock2.h
+
+#ifdef _WIN32
+#include <windows.h>
+
 #include "glut.h"
+#else
+#include <GL/glut.h>
+#include <sys/resource.h>
+#endif
+
+#include "profiler.h"
+#include "text_cache.h"
+#include "worker_pool.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -16,15 +45,9 @@
 
 using namespace std;
 
-// Maze dimensions
-const int MAZE_WIDTH = 10;
-const int MAZE_HEIGHT = 10;
-
-// Cell structure
-struct Cell {
-    bool visited = false;
-    bool walls[4] = {true, true, true, true};  // North, East, South, West
-};
+// Maze dimensions, the game uses 10x10; benchmarks generate larger ones
+int mazeWidth = 10;
+int mazeHeight = 10;
 
 // Player position and orientation
 float playerX = 1.5f;
@@ -36,53 +59,317 @@ float playerAngle = 0.0f;
 enum ViewMode { FIRST_PERSON, BIRD_EYE };
 ViewMode currentView = FIRST_PERSON;
 
-// Maze data
-Cell maze[MAZE_WIDTH][MAZE_HEIGHT];
+// How FIRST_PERSON is drawn, 'c' switches: wall quads, or one ray per
+// screen column through the wall planes into a CPU framebuffer
+enum FirstPersonRenderer { RENDER_GEOMETRY, RENDER_RAYCAST };
+FirstPersonRenderer firstPersonRenderer = RENDER_GEOMETRY;
+
+// Everything that lives as long as one maze: the grid, the generation
+// stack, the wall planes, the solver buffers and the map mesh. layoutMaze()
+// resets it, so regenerating a maze of the same size allocates nothing.
+Arena mazeArena;
+
+// Maze data, in mazeArena
+MazeGrid maze;
+
+// The same walls as bit-planes, 64 cells per word, rebuilt after generation.
+// horizontal: row z (0..height) bit x is the wall on the north side of cell
+// (x, z); row height is the south border. vertical: row z bit x (0..width)
+// is the wall on the west side of (x, z); bit width is the east border.
+// Rows carry one zero word on each side so word i - 1 and i + 1 are always
+// addressable. The rows are in mazeArena.
+struct WallPlanes {
+    int width, height;
+    int words;   // data words per row
+    int stride;  // words + 2
+    uint64_t *horizontal;
+    uint64_t *vertical;
+    uint64_t *cellMask;  // one row, bits 0..width-1
+
+    size_t at(int z, int word) const { return (size_t)z * stride + word + 1; }
+};
+WallPlanes walls;
+
+// Work space of floodFill() and analyzeMaze(), one entry per vertical-plane
+// word each, laid out with the planes
+struct SolverBuffers {
+    uint64_t *reached;   // floodFill()'s result
+    uint64_t *next;      // bits found for the next level, or handed to a word
+    uint64_t *frontier;
+    uint64_t *seen;      // cells in components found so far
+    size_t *active;      // words of the frontier, or waiting to be filled
+    size_t *touched;     // words of the next level
+};
+SolverBuffers solver;
+
+// Difficulty metrics from analyzeMaze(), refreshed by generateMaze()
+struct MazeStats {
+    int components;
+    long deadEnds;
+    long junctions;         // cells with three or four openings
+    int longestPath;        // steps between the two farthest cells
+    double branching;       // mean onward choices at a junction
+    double analysisMs;
+};
+MazeStats mazeStats;
 
 // Add maze destination
-int destX = MAZE_WIDTH - 2;
-int destZ = MAZE_HEIGHT - 2;
+int destX = mazeWidth - 2;
+int destZ = mazeHeight - 2;
 bool reachedDestination = false;
 
 // Add a variable to track if the player has reached the destination
 bool gameWon = false;
 
-void initMaze();
+// Maze generation seed, 0 picks a random one
+unsigned int mazeSeed = 0;
+
+// A maze and everything derived from it, in an arena of its own. buildMaze()
+// fills one, on a worker thread if need be, and installMaze() swaps it with
+// the maze being played: the globals above.
+struct MazeBuffer {
+    Arena arena;
+    MazeGrid grid;
+    WallPlanes walls;
+    SolverBuffers solver;
+    MazeStats stats;
+    int width, height;
+    int destX, destZ;
+    unsigned int seed;
+};
+
+// The next maze is built here. 'r' builds it on regenWorker while play goes
+// on in the current one, and a timer swaps it in once regenReady is set. A
+// win starts the build right away, so the 'r' that follows is instant.
+MazeBuffer backMaze;
+thread regenWorker;
+atomic<bool> regenReady(false);
+bool restartPending = false;  // install the new maze as soon as it is built
+const int REGEN_POLL_MS = 16;
+
+// Instrumentation overlay ('p'), 't' writes a Chrome trace
+bool showProfile = false;
+
+// HUD and success screen strings
+TextCache textCache;
+
+// Window size from reshape()
+int windowWidth = 800;
+int windowHeight = 600;
+
+// View-independent wall geometry for the map views: every wall once, as
+// a line in cell units. Rebuilt only when the maze changes.
+struct MazeMesh {
+    unsigned int version;
+    const float *wallLines;  // x0, z0, x1, z1 per wall, in mazeArena
+    size_t wallCount;
+};
+MazeMesh mazeMesh;
+unsigned int mazeVersion = 0;  // bumped by installMaze()
+
+// What one frame shows, captured once at the top of display(). Every view
+// of a layout draws from it, so they cannot disagree about the state.
+struct FrameSnapshot {
+    float playerX, playerY, playerZ, playerAngle;
+    int playerCellX, playerCellZ;  // highlighted on the maps
+    int destX, destZ;
+    int width, height;  // maze
+    bool won;
+    const MazeGrid *maze;
+    const WallPlanes *walls;
+    const MazeMesh *mesh;
+    const vector<float> *others;  // remote players, x, z, angle each
+};
+
+struct Viewport {
+    int x, y, width, height;
+};
+
+// Screen layouts, 'v' cycles: a single view picked with 'f'/'b', first
+// person beside the bird's-eye map, or first person with map insets
+enum Layout { LAYOUT_SINGLE, LAYOUT_SPLIT, LAYOUT_PIP };
+Layout layout = LAYOUT_SINGLE;
+
+// Input since the last frame. The callbacks only add to it and post a
+// redisplay; applyInput() at the top of display() applies it all at once,
+// so a burst of mouse or key-repeat events costs one update and one frame.
+InputState input;
+
+// Relative mouse-look, 'm' toggles: the cursor is hidden and warped back
+// to the middle of the window before it can reach an edge
+bool mouseLook = false;
+int lastMouseX = -1;
+const double MOUSE_SENSITIVITY = 0.004;  // radians per pixel
+
+// Multiplayer race (maze_net.h): --host PORT, or --join PORT on the same box
+NetHost *netHost = NULL;
+NetClient *netClient = NULL;
+int netId = 0;                // ours, the host is 0
+vector<float> remotePlayers;  // x, z, angle of everyone else
+int raceWinner = -1;          // first player at the destination
+unsigned int mazeSeedUsed = 0;
+const int NET_TICK_MS = 33;
+
+// Raycaster view, the same frustum as gluPerspective(60, aspect, 0.1, 100)
+// and gluLookAt() in display()
+struct RaycastCamera {
+    float x, z;            // eye, at playerY
+    float dirX, dirZ;      // forward
+    float rightX, rightZ;  // screen right
+    float focal;           // pixels from the eye to the image plane
+    float centerX, centerY;
+};
+
+// Pixels bottom row first, as glDrawPixels() takes them
+struct RaycastFrame {
+    int width, height;
+    vector<uint32_t> pixels;
+    vector<float> depth;  // per column, distance along the view direction
+};
+RaycastFrame raycastFrame;
+
+const float RAYCAST_FAR = 100.0f;
+
+// Cell culling for the geometry renderer, 'o' toggles. Walls are full
+// height with the eye between floor and ceiling, so a wall hides all
+// geometry behind it in the screen columns it spans: the occlusion buffer
+// keeps one depth per band of OCCLUSION_BAND columns, plus the maximum of
+// every OCCLUSION_BLOCK bands for early rejects.
+const int OCCLUSION_BAND = 4;
+const int OCCLUSION_BLOCK = 8;
+struct OcclusionBuffer {
+    int bands, blocks;
+    vector<float> depth;     // nearest fully covering wall's far depth per band
+    vector<float> blockMax;  // max of depth over each block
+};
+
+struct CullStats {
+    int submitted;
+    int frustumRejected;
+    int occlusionRejected;
+    double traversalMs;
+};
+bool cullCells = true;
+CullStats cullStats;
+
+unsigned int workerCount = max(1u, thread::hardware_concurrency());
+WorkerPool workers((int)workerCount);  // raycaster column strips
+
+void layoutMaze(MazeBuffer &m);
+unsigned int pickMazeSeed();
+void buildMaze(MazeBuffer &m);
+void installMaze(MazeBuffer &m);
 void generateMaze();
-void ensurePathToDestination();
-void idle();
+void startRegeneration();
+void waitForRegeneration();
+void ensurePathToDestination(MazeBuffer &m);
+void buildWallPlanes(WallPlanes &p, const MazeGrid &grid);
+long countOpenings(const WallPlanes &p);
+long countDeadEnds(const WallPlanes &p);
+int floodFill(const WallPlanes &p, SolverBuffers &buffers, int startX, int startZ, int *lastX = NULL,
+              int *lastZ = NULL);
+void analyzeMaze(const WallPlanes &p, SolverBuffers &buffers, MazeStats &stats);
+void benchAnalysis();
+void benchRegen();
+void benchWalls();
 void init();
 void display();
-void drawMaze();
-void drawCell(int x, int z);
-void drawPlayer();
+FrameSnapshot takeSnapshot();
+void drawFirstPerson(const FrameSnapshot &s, const Viewport &vp);
+void drawMaze(const FrameSnapshot &s, const Viewport &vp);
+void collectVisibleCells(const FrameSnapshot &s, const RaycastCamera &cam, int width, vector<int> &cells,
+                         CullStats &stats);
+void benchOcclusion();
+void drawCells(const FrameSnapshot &s, const vector<int> *cells);
+void drawPlayer(const FrameSnapshot &s, ViewMode view);
+RaycastCamera raycastCamera(const FrameSnapshot &s, int width, int height);
+void castFrame(RaycastFrame &frame, const FrameSnapshot &s, const RaycastCamera &cam, int width, int height,
+               int threads, bool simd = true);
+void drawRaycast(const FrameSnapshot &s, const Viewport &vp);
+void benchRaycast();
 void reshape(int w, int h);
 void keyboard(unsigned char key, int x, int y);
 void mouseFunc(int button, int state, int x, int y);
-void drawMiniMap();
-void drawBirdEyeView();
+void mouseMotion(int x, int y);
+void applyInput();
+void restartGame();
+void pollRegeneration(int value);
+NetMaze packMaze();
+void loadMaze(const NetMaze &m);
+void netTick(int value);
+void benchNet();
+void drawMiniMap(const FrameSnapshot &s, const Viewport &vp);
+void drawBirdEyeView(const FrameSnapshot &s, const Viewport &vp, bool hints);
 void drawSuccessScreen();
 
-// Direction vectors (North, East, South, West)
-const int dx[4] = {0, 1, 0, -1};
-const int dz[4] = {-1, 0, 1, 0};
-
 int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "--bench-walls") == 0) {
+        benchWalls();
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-analysis") == 0) {
+        benchAnalysis();
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-regen") == 0) {
+        benchRegen();
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-raycast") == 0) {
+        benchRaycast();
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-occlusion") == 0) {
+        benchOcclusion();
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-net") == 0) {
+        benchNet();
+        return 0;
+    }
+    int hostPort = 0, joinPort = 0;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--seed") == 0) mazeSeed = (unsigned int)atoi(argv[i + 1]);
+        if (strcmp(argv[i], "--host") == 0) hostPort = atoi(argv[i + 1]);
+        if (strcmp(argv[i], "--join") == 0) joinPort = atoi(argv[i + 1]);
+    }
+
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
     glutInitWindowSize(800, 600);
     glutInitWindowPosition(100, 100);
     glutCreateWindow("3D Maze");
 
+    // Nothing animates: frames are drawn on input, reshape and expose only,
+    // so static screens (success, bird's-eye) cost nothing while idle
     glutDisplayFunc(display);
-    glutIdleFunc(idle);
     glutKeyboardFunc(keyboard);
     glutReshapeFunc(reshape);
     glutMouseFunc(mouseFunc);
+    glutMotionFunc(mouseMotion);
+    glutPassiveMotionFunc(mouseMotion);
 
     init();
-    initMaze();
     generateMaze();
+    atexit(waitForRegeneration);  // a build in progress still uses backMaze
+
+    // A client shows its own maze until the host's arrives on the first tick
+    if (hostPort) {
+        netHost = new NetHost;
+        if (!netHost->listen(hostPort)) {
+            cout << "Cannot listen on port " << hostPort << endl;
+            return 1;
+        }
+        netHost->setMaze(packMaze());
+        cout << "Hosting a race on port " << netHost->port() << endl;
+    } else if (joinPort) {
+        netClient = new NetClient;
+        if (!netClient->connect(joinPort)) {
+            cout << "Cannot connect to port " << joinPort << endl;
+            return 1;
+        }
+    }
+    if (netHost || netClient) glutTimerFunc(NET_TICK_MS, netTick, 0);
 
     glutMainLoop();
     return 0;
@@ -113,6 +400,8 @@ void init() {
 
 void reshape(int w, int h) {
     if (h == 0) h = 1;
+    windowWidth = w;
+    windowHeight = h;
     glViewport(0, 0, w, h);
 
     glMatrixMode(GL_PROJECTION);
@@ -123,181 +412,207 @@ void reshape(int w, int h) {
     glMatrixMode(GL_MODELVIEW);
 }
 
-void idle() {
-    glutPostRedisplay();
-}
-
 void display() {
+    profiler().beginFrame();
+    PROFILE_SCOPE("display");
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glLoadIdentity();
 
     // Disable lighting completely to avoid issues
     glDisable(GL_LIGHTING);
 
+    applyInput();
+
     // Check if player has reached the destination
-    if (!gameWon && floor(playerX) == destX && floor(playerZ) == destZ) {
+    if (!gameWon && atDestination(playerX, playerZ, destX, destZ)) {
         gameWon = true;
+        if (!netClient) startRegeneration();  // the next maze, while the success screen shows
     }
 
+    FrameSnapshot snap = takeSnapshot();
+    Viewport window = {0, 0, windowWidth, windowHeight};
+
     // If game is won, display success message
-    if (gameWon) {
+    if (snap.won) {
         drawSuccessScreen();
+    } else if (layout == LAYOUT_SPLIT) {
+        Viewport left = {0, 0, windowWidth / 2, windowHeight};
+        Viewport right = {windowWidth / 2, 0, windowWidth - windowWidth / 2, windowHeight};
+        drawFirstPerson(snap, left);
+        drawMiniMap(snap, left);
+        drawBirdEyeView(snap, right, false);
+    } else if (layout == LAYOUT_PIP) {
+        Viewport inset = {windowWidth - windowWidth / 3 - 10, windowHeight - windowHeight / 3 - 10, windowWidth / 3,
+                          windowHeight / 3};
+        drawFirstPerson(snap, window);
+        drawMiniMap(snap, window);
+        drawBirdEyeView(snap, inset, false);
     } else if (currentView == FIRST_PERSON) {
-        // First-person view
-        float lookX = playerX + cos(playerAngle);
-        float lookZ = playerZ + sin(playerAngle);
-        gluLookAt(playerX, playerY, playerZ, lookX, playerY, lookZ, 0.0, 1.0, 0.0);
-
-        // Draw the 3D maze in first-person view
-        drawMaze();
-        drawPlayer();
+        drawFirstPerson(snap, window);
     } else {
-        // Save the current matrices
-        glMatrixMode(GL_PROJECTION);
-        glPushMatrix();
-        glLoadIdentity();
-        gluOrtho2D(0, glutGet(GLUT_WINDOW_WIDTH), 0, glutGet(GLUT_WINDOW_HEIGHT));
-
-        glMatrixMode(GL_MODELVIEW);
-        glPushMatrix();
-        glLoadIdentity();
-
-        // Draw a 2D representation of the maze
-        drawBirdEyeView();
-
-        glMatrixMode(GL_PROJECTION);
-        glPopMatrix();
-        glMatrixMode(GL_MODELVIEW);
-        glPopMatrix();
+        drawBirdEyeView(snap, window, true);
     }
+    glViewport(0, 0, windowWidth, windowHeight);
 
+    if (showProfile) profiler().drawOverlay(windowHeight);
     glutSwapBuffers();
 }
 
-void initMaze() {
-    for (int x = 0; x < MAZE_WIDTH; x++) {
-        for (int z = 0; z < MAZE_HEIGHT; z++) {
-            maze[x][z].visited = false;
-
-            // Set all walls initially
-            for (int i = 0; i < 4; i++) {
-                maze[x][z].walls[i] = true;
-            }
+inline int popcount64(uint64_t v) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(v);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    return (int)__popcnt64(v);
+#else
+    v = v - ((v >> 1) & 0x5555555555555555ULL);
+    v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+    v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int)((v * 0x0101010101010101ULL) >> 56);
+#endif
+}
 
-            // But ensure outer walls are never broken
-            if (x == 0) maze[x][z].walls[3] = true;                // Left edge
-            if (x == MAZE_WIDTH - 1) maze[x][z].walls[1] = true;   // Right edge
-            if (z == 0) maze[x][z].walls[0] = true;                // Top edge
-            if (z == MAZE_HEIGHT - 1) maze[x][z].walls[2] = true;  // Bottom edge
+// Counted first, so the lines take exactly their size from mazeArena
+void buildMazeMesh(MazeMesh &m, const WallPlanes &p) {
+    size_t count = 0;
+    for (size_t i = 0; i < (size_t)(p.height + 1) * p.stride; i++) count += popcount64(p.horizontal[i]);
+    for (size_t i = 0; i < (size_t)p.height * p.stride; i++) count += popcount64(p.vertical[i]);
+
+    float *line = mazeArena.alloc<float>(count * 4);
+    m.wallLines = line;
+    m.wallCount = count;
+    for (int z = 0; z <= p.height; z++) {
+        for (int x = 0; x < p.width; x++) {
+            if (!(p.horizontal[p.at(z, x >> 6)] >> (x & 63) & 1)) continue;
+            line[0] = (float)x;
+            line[1] = line[3] = (float)z;
+            line[2] = x + 1.0f;
+            line += 4;
+        }
+    }
+    for (int z = 0; z < p.height; z++) {
+        for (int x = 0; x <= p.width; x++) {
+            if (!(p.vertical[p.at(z, x >> 6)] >> (x & 63) & 1)) continue;
+            line[0] = line[2] = (float)x;
+            line[1] = (float)z;
+            line[3] = z + 1.0f;
+            line += 4;
         }
     }
 }
 
-void generateMaze() {
-    random_device rd;
-    mt19937 gen(rd());
-
-    // Reset destination reached flag
-    reachedDestination = false;
-
-    // Set maze destination closer to the far corner but not at the perimeter
-    destX = MAZE_WIDTH - 2;
-    destZ = MAZE_HEIGHT - 2;
-
-    stack<pair<int, int>> cellStack;
-    int startX = 1;
-    int startZ = 1;
+FrameSnapshot takeSnapshot() {
+    if (mazeMesh.version != mazeVersion) {
+        buildMazeMesh(mazeMesh, walls);
+        mazeMesh.version = mazeVersion;
+    }
 
-    // Initialize all cells as unvisited with all walls intact
-    for (int x = 0; x < MAZE_WIDTH; x++) {
-        for (int z = 0; z < MAZE_HEIGHT; z++) {
-            maze[x][z].visited = false;
+    FrameSnapshot s;
+    s.playerX = playerX;
+    s.playerY = playerY;
+    s.playerZ = playerZ;
+    s.playerAngle = playerAngle;
+    s.playerCellX = (int)floor(playerX);
+    s.playerCellZ = (int)floor(playerZ);
+    s.destX = destX;
+    s.destZ = destZ;
+    s.width = mazeWidth;
+    s.height = mazeHeight;
+    s.won = gameWon;
+    s.maze = &maze;
+    s.walls = &walls;
+    s.mesh = &mazeMesh;
+    s.others = &remotePlayers;
+    return s;
+}
 
-            // Set all walls initially
-            for (int i = 0; i < 4; i++) {
-                maze[x][z].walls[i] = true;
-            }
+// The 3D view in vp, with its own projection for the viewport's aspect
+void drawFirstPerson(const FrameSnapshot &s, const Viewport &vp) {
+    glViewport(vp.x, vp.y, vp.width, vp.height);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    gluPerspective(60.0, (GLfloat)vp.width / (GLfloat)vp.height, 0.1, 100.0);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
 
-            // But ensure outer walls are never broken
-            if (x == 0) maze[x][z].walls[3] = true;                // Left edge
-            if (x == MAZE_WIDTH - 1) maze[x][z].walls[1] = true;   // Right edge
-            if (z == 0) maze[x][z].walls[0] = true;                // Top edge
-            if (z == MAZE_HEIGHT - 1) maze[x][z].walls[2] = true;  // Bottom edge
-        }
+    if (firstPersonRenderer == RENDER_RAYCAST) {
+        drawRaycast(s, vp);
+        return;
     }
 
+    float lookX = s.playerX + cos(s.playerAngle);
+    float lookZ = s.playerZ + sin(s.playerAngle);
+    gluLookAt(s.playerX, s.playerY, s.playerZ, lookX, s.playerY, lookZ, 0.0, 1.0, 0.0);
 
-    maze[startX][startZ].visited = true;
-    cellStack.push(make_pair(startX, startZ));
-
-    while (!cellStack.empty()) {
-        pair<int, int> current = cellStack.top();
-        int x = current.first;
-        int z = current.second;
-
-        // Find unvisited neighbors
-        vector<int> neighbors;
-        for (int i = 0; i < 4; i++) {
-            int nx = x + dx[i];
-            int nz = z + dz[i];
+    drawMaze(s, vp);
+    drawPlayer(s, FIRST_PERSON);
+}
 
-            // Make sure we don't go outside the maze boundaries
-            if (nx >= 0 && nx < MAZE_WIDTH && nz >= 0 && nz < MAZE_HEIGHT && !maze[nx][nz].visited) {
-                neighbors.push_back(i);
-            }
-        }
+// Lays out an m.width x m.height maze in m's reset arena: the grid, the
+// wall planes and the solver buffers. The cells are left for buildMaze() or
+// loadMaze(), which set each of them once.
+void layoutMaze(MazeBuffer &m) {
+    m.arena.reset();
+    m.grid.place(m.arena.alloc<Cell>((size_t)m.width * m.height), m.width, m.height);
+
+    WallPlanes &p = m.walls;
+    p.width = m.width;
+    p.height = m.height;
+    p.words = (m.width + 1 + 63) / 64;  // + 1 for the east border bit
+    p.stride = p.words + 2;
+    p.horizontal = m.arena.alloc<uint64_t>((size_t)(m.height + 1) * p.stride);
+    p.vertical = m.arena.alloc<uint64_t>((size_t)m.height * p.stride);
+    p.cellMask = m.arena.alloc<uint64_t>(p.stride);
+
+    size_t words = (size_t)m.height * p.stride;
+    m.solver.reached = m.arena.alloc<uint64_t>(words);
+    m.solver.next = m.arena.alloc<uint64_t>(words);
+    m.solver.frontier = m.arena.alloc<uint64_t>(words);
+    m.solver.seen = m.arena.alloc<uint64_t>(words);
+    m.solver.active = m.arena.alloc<size_t>(words);
+    m.solver.touched = m.arena.alloc<size_t>(words);
+}
 
-        if (!neighbors.empty()) {
-            // Randomly choose a neighbor
-            shuffle(neighbors.begin(), neighbors.end(), gen);
-
-            if (rand() % 5 == 0) {  // 20% chance to bias toward destination
-                // Find any neighbor that gets us closer to destination
-                for (size_t i = 0; i < neighbors.size(); i++) {
-                    int dir = neighbors[i];
-                    int nx = x + dx[dir];
-                    int nz = z + dz[dir];
-
-                    // Calculate Manhattan distance to destination
-                    int currDist = abs(x - destX) + abs(z - destZ);
-                    int newDist = abs(nx - destX) + abs(nz - destZ);
-
-                    // If this neighbor gets us closer to destination, prioritize it
-                    if (newDist < currDist) {
-                        swap(neighbors[0], neighbors[i]);  // Move this direction to front
-                        break;
-                    }
-                }
-            }
+// rand() also shapes the maze, so a fixed seed pins it too. Called on the
+// main thread before a build starts.
+unsigned int pickMazeSeed() {
+    if (mazeSeed) srand(mazeSeed);
+    return mazeSeed ? mazeSeed : random_device()();
+}
 
-            int nextDir = neighbors[0];
+// Generates an m.width x m.height maze from m.seed. It touches no globals
+// but rand(), which only the builds use, so it can run on regenWorker.
+void buildMaze(MazeBuffer &m) {
+    mt19937 gen(m.seed);
+    layoutMaze(m);
 
-            int nx = x + dx[nextDir];
-            int nz = z + dz[nextDir];
+    // Set maze destination closer to the far corner but not at the perimeter
+    m.destX = m.width - 2;
+    m.destZ = m.height - 2;
 
-            // Don't allow breaking outer walls
-            bool canBreakWall = true;
-            if ((x == 0 && nextDir == 3) || (x == MAZE_WIDTH - 1 && nextDir == 1) || (z == 0 && nextDir == 0) ||
-                (z == MAZE_HEIGHT - 1 && nextDir == 2)) {
-                canBreakWall = false;
-            }
+    uint32_t *cellStack = m.arena.alloc<uint32_t>((size_t)m.width * m.height);
+    carveMaze(m.grid, m.width, m.height, m.destX, m.destZ, gen, rand, cellStack);
+    ensurePathToDestination(m);
+    analyzeMaze(m.walls, m.solver, m.stats);
+}
 
-            if (canBreakWall) {
-                // Remove the wall between current cell and chosen neighbor
-                maze[x][z].walls[nextDir] = false;              // Remove current cell's wall
-                maze[nx][nz].walls[(nextDir + 2) % 4] = false;  // Remove neighbor's opposite wall
-            }
+// The maze in m becomes the one played and drawn, with the player back at
+// the start. The old one goes to m, whose arena the next build reuses. Only
+// pointers are swapped, so this takes no time whatever the size.
+void installMaze(MazeBuffer &m) {
+    mazeArena.swap(m.arena);
+    swap(maze, m.grid);
+    swap(walls, m.walls);
+    swap(solver, m.solver);
+    mazeStats = m.stats;
+    mazeWidth = m.width;
+    mazeHeight = m.height;
+    destX = m.destX;
+    destZ = m.destZ;
+    mazeSeedUsed = m.seed;
+    mazeVersion++;
 
-            // Mark the neighbor as visited and push it onto the stack
-            maze[nx][nz].visited = true;
-            cellStack.push(make_pair(nx, nz));
-        } else {
-            // Backtrack if no unvisited neighbors
-            cellStack.pop();
-        }
-    }
-
-    ensurePathToDestination();
+    // Reset destination reached flag
+    reachedDestination = false;
 
     // Set player starting position
     playerX = 1.5f;
@@ -306,47 +621,48 @@ void generateMaze() {
     playerAngle = 0.0f;
 }
 
-void ensurePathToDestination() {
-    // Reset visited flags
-    for (int x = 0; x < MAZE_WIDTH; x++) {
-        for (int z = 0; z < MAZE_HEIGHT; z++) {
-            maze[x][z].visited = false;
-        }
-    }
-
-    // DFS to check if there's a path
-    stack<pair<int, int>> pathStack;
-    pathStack.push(make_pair(1, 1));  // Start position
-    maze[1][1].visited = true;
+// A mazeWidth x mazeHeight maze, built and installed before returning: at
+// startup, in the benchmarks and in the harness
+void generateMaze() {
+    waitForRegeneration();
+    backMaze.width = mazeWidth;
+    backMaze.height = mazeHeight;
+    backMaze.seed = pickMazeSeed();
+    buildMaze(backMaze);
+    installMaze(backMaze);
+}
 
-    while (!pathStack.empty()) {
-        pair<int, int> current = pathStack.top();
-        pathStack.pop();
+// Builds the next mazeWidth x mazeHeight maze on regenWorker, unless one is
+// being built or waits to be installed
+void startRegeneration() {
+    if (regenWorker.joinable()) return;
+    backMaze.width = mazeWidth;
+    backMaze.height = mazeHeight;
+    backMaze.seed = pickMazeSeed();
+    regenReady.store(false, memory_order_relaxed);
+    regenWorker = thread([] {
+        buildMaze(backMaze);
+        regenReady.store(true, memory_order_release);
+    });
+}
 
-        int x = current.first;
-        int z = current.second;
+// Drops a build in progress or waiting, so backMaze is free again
+void waitForRegeneration() {
+    if (regenWorker.joinable()) regenWorker.join();
+    restartPending = false;
+}
 
-        if (x == destX && z == destZ) {
-            return;  // Path exists, no need to modify the maze
-        }
+void ensurePathToDestination(MazeBuffer &m) {
+    buildWallPlanes(m.walls, m.grid);
 
-        for (int dir = 0; dir < 4; dir++) {
-            // If there's no wall in this direction
-            if (!maze[x][z].walls[dir]) {
-                int nx = x + dx[dir];
-                int nz = z + dz[dir];
-
-                // If this neighbor hasn't been visited
-                if (!maze[nx][nz].visited) {
-                    maze[nx][nz].visited = true;
-                    pathStack.push(make_pair(nx, nz));
-                }
-            }
-        }
+    floodFill(m.walls, m.solver, 1, 1);
+    if (m.solver.reached[m.walls.at(m.destZ, m.destX >> 6)] >> (m.destX & 63) & 1) {
+        return;  // Path exists, no need to modify the maze
     }
 
-    int x = destX;
-    int z = destZ;
+    MazeGrid &maze = m.grid;
+    int x = m.destX;
+    int z = m.destZ;
 
     while (x > 1 || z > 1) {
         if (x > 1 && z > 1) {
@@ -369,173 +685,826 @@ void ensurePathToDestination() {
             z--;
         }
     }
+    buildWallPlanes(m.walls, m.grid);
+}
+
+
+// From grid into the rows layoutMaze() laid out
+void buildWallPlanes(WallPlanes &p, const MazeGrid &grid) {
+    memset(p.horizontal, 0, (size_t)(p.height + 1) * p.stride * sizeof(uint64_t));
+    memset(p.vertical, 0, (size_t)p.height * p.stride * sizeof(uint64_t));
+    memset(p.cellMask, 0, p.stride * sizeof(uint64_t));
+
+    for (int x = 0; x < p.width; x++) {
+        uint64_t bit = 1ULL << (x & 63);
+        int w = x >> 6;
+        p.cellMask[w + 1] |= bit;
+        for (int z = 0; z < p.height; z++) {
+            const Cell &c = grid[x][z];
+            if (c.walls[0]) p.horizontal[p.at(z, w)] |= bit;
+            if (c.walls[3]) p.vertical[p.at(z, w)] |= bit;
+        }
+        if (grid[x][p.height - 1].walls[2]) p.horizontal[p.at(p.height, w)] |= bit;
+    }
+    int e = p.width;
+    for (int z = 0; z < p.height; z++) {
+        if (grid[p.width - 1][z].walls[1]) p.vertical[p.at(z, e >> 6)] |= 1ULL << (e & 63);
+    }
 }
 
-void drawMaze() {
+// Wall on the east side of every cell of word i: the west bits shifted down
+// by one, with bit 63 coming from the next word
+inline uint64_t eastWalls(const uint64_t *vrow, int i) { return (vrow[i] >> 1) | (vrow[i + 1] << 63); }
+
+// Passages between two cells: interior horizontal and vertical wall slots
+// that are open
+long countOpenings(const WallPlanes &p) {
+    long open = 0;
+    for (int z = 0; z < p.height; z++) {
+        const uint64_t *v = &p.vertical[p.at(z, 0)];
+        for (int i = 0; i < p.words; i++) {
+            // The east border is always a wall, so the last column adds nothing
+            open += popcount64(~eastWalls(v, i) & p.cellMask[i + 1]);
+            if (z > 0) open += popcount64(~p.horizontal[p.at(z, i)] & p.cellMask[i + 1]);
+        }
+    }
+    return open;
+}
+
+// Cells with exactly three walls
+long countDeadEnds(const WallPlanes &p) {
+    long ends = 0;
+    for (int z = 0; z < p.height; z++) {
+        const uint64_t *n = &p.horizontal[p.at(z, 0)];
+        const uint64_t *s = &p.horizontal[p.at(z + 1, 0)];
+        const uint64_t *w = &p.vertical[p.at(z, 0)];
+        const uint64_t *mask = &p.cellMask[1];
+        int i = 0;
+#ifdef __AVX2__
+        // Four words per step; the shifted east load reads word i + 4, which
+        // is at most the zero pad word
+        for (; i + 4 <= p.words; i += 4) {
+            __m256i vn = _mm256_loadu_si256((const __m256i *)(n + i));
+            __m256i vs = _mm256_loadu_si256((const __m256i *)(s + i));
+            __m256i vw = _mm256_loadu_si256((const __m256i *)(w + i));
+            __m256i vnext = _mm256_loadu_si256((const __m256i *)(w + i + 1));
+            __m256i ve = _mm256_or_si256(_mm256_srli_epi64(vw, 1), _mm256_slli_epi64(vnext, 63));
+            __m256i ns = _mm256_and_si256(vn, vs), we = _mm256_and_si256(vw, ve);
+            __m256i atLeast3 = _mm256_or_si256(_mm256_and_si256(ns, _mm256_or_si256(vw, ve)),
+                                               _mm256_and_si256(we, _mm256_or_si256(vn, vs)));
+            __m256i three = _mm256_andnot_si256(_mm256_and_si256(ns, we), atLeast3);
+            three = _mm256_and_si256(three, _mm256_loadu_si256((const __m256i *)(mask + i)));
+            ends += popcount64((uint64_t)_mm256_extract_epi64(three, 0)) +
+                    popcount64((uint64_t)_mm256_extract_epi64(three, 1)) +
+                    popcount64((uint64_t)_mm256_extract_epi64(three, 2)) +
+                    popcount64((uint64_t)_mm256_extract_epi64(three, 3));
+        }
+#endif
+        for (; i < p.words; i++) {
+            uint64_t e = eastWalls(w, i);
+            uint64_t ns = n[i] & s[i], we = w[i] & e;
+            uint64_t atLeast3 = (ns & (w[i] | e)) | (we & (n[i] | s[i]));
+            ends += popcount64(atLeast3 & ~(ns & we) & mask[i]);
+        }
+    }
+    return ends;
+}
+
+// Breadth-first flood from (startX, startZ) that moves whole words at a
+// time: each frontier word spreads east and west with a shift and north and
+// south with a mask. Only words touched by the frontier are visited, so long
+// corridors cost per level what they cost cell by cell. reached gets one bit
+// per reachable cell in the vertical plane's layout; returns the number of
+// levels, the start's eccentricity, and optionally one cell of the last level.
+// A word joins the next level once, so active and touched fit one entry per
+// word.
+int floodFill(const WallPlanes &p, SolverBuffers &buffers, int startX, int startZ, int *lastX, int *lastZ) {
+    size_t size = (size_t)p.height * p.stride;
+    uint64_t *reached = buffers.reached, *next = buffers.next, *frontier = buffers.frontier;
+    memset(reached, 0, size * sizeof(uint64_t));
+    memset(next, 0, size * sizeof(uint64_t));
+    memset(frontier, 0, size * sizeof(uint64_t));
+    size_t *active = buffers.active, *touched = buffers.touched;
+    size_t activeCount = 0, touchedCount = 0;
+
+    size_t start = p.at(startZ, startX >> 6);
+    reached[start] = 1ULL << (startX & 63);
+    frontier[start] = reached[start];
+    active[activeCount++] = start;
+
+    int levels = 0;
+    while (true) {
+        for (size_t k = 0; k < activeCount; k++) {
+            size_t idx = active[k];
+            int z = (int)(idx / p.stride);
+            uint64_t f = frontier[idx];
+            const uint64_t *v = &p.vertical[idx];
+
+            uint64_t east = f & ~((v[0] >> 1) | (v[1] << 63));
+            uint64_t west = f & ~v[0];
+            uint64_t north = f & ~p.horizontal[idx];
+            uint64_t south = f & ~p.horizontal[idx + p.stride];
+
+            size_t targets[6] = {idx, idx + 1, idx, idx - 1, idx - p.stride, idx + p.stride};
+            uint64_t bits[6] = {east << 1, east >> 63, west >> 1, west << 63, north, south};
+            // Border walls keep every move inside the grid; rows only need
+            // their own bounds check
+            if (z == 0) bits[4] = 0;
+            if (z == p.height - 1) bits[5] = 0;
+
+            for (int t = 0; t < 6; t++) {
+                uint64_t b = bits[t];
+                if (!b) continue;
+                b &= ~reached[targets[t]];
+                if (!b) continue;
+                if (!next[targets[t]]) touched[touchedCount++] = targets[t];
+                next[targets[t]] |= b;
+            }
+        }
+        if (!touchedCount) {
+            if (lastX && lastZ) {
+                size_t idx = active[0];
+                uint64_t f = frontier[idx];
+                *lastZ = (int)(idx / p.stride);
+                *lastX = (int)(idx % p.stride - 1) * 64 + popcount64((f & (~f + 1)) - 1);
+            }
+            break;
+        }
+        for (size_t k = 0; k < activeCount; k++) frontier[active[k]] = 0;
+
+        levels++;
+        for (size_t k = 0; k < touchedCount; k++) {
+            size_t idx = touched[k];
+            reached[idx] |= next[idx];
+            frontier[idx] = next[idx];
+            next[idx] = 0;
+        }
+        swap(active, touched);
+        activeCount = touchedCount;
+        touchedCount = 0;
+    }
+    return levels;
+}
+
+// Cells by number of walls (0..4), 64 at a time: the four wall bits of each
+// cell are summed in bit-sliced form (ones, twos, fours)
+void wallHistogram(const WallPlanes &p, long hist[5]) {
+    for (int k = 0; k < 5; k++) hist[k] = 0;
+    for (int z = 0; z < p.height; z++) {
+        const uint64_t *n = &p.horizontal[p.at(z, 0)];
+        const uint64_t *s = &p.horizontal[p.at(z + 1, 0)];
+        const uint64_t *w = &p.vertical[p.at(z, 0)];
+        for (int i = 0; i < p.words; i++) {
+            uint64_t e = eastWalls(w, i), mask = p.cellMask[i + 1];
+            uint64_t a = n[i] ^ s[i], c1 = n[i] & s[i];
+            uint64_t b = w[i] ^ e, c2 = w[i] & e;
+            uint64_t ones = a ^ b, twos = c1 ^ c2 ^ (a & b), fours = c1 & c2;
+            hist[0] += popcount64(~ones & ~twos & ~fours & mask);
+            hist[1] += popcount64(ones & ~twos & mask);
+            hist[2] += popcount64(~ones & twos & mask);
+            hist[3] += popcount64(ones & twos & mask);
+            hist[4] += popcount64(fours & mask);
+        }
+    }
+}
+
+// Marks everything connected to the seed bits of word idx. Unlike the
+// level-by-level floodFill() there are no distances here, so each word is
+// first grown to a fixpoint along its row and only then hands new bits to
+// its neighbours; a word is revisited only when a neighbour adds to it.
+// Handed-over bits wait in buffers.next, and a word is on the buffers.active
+// stack at most once, so both fit one entry per word.
+inline void handOver(uint64_t *pending, size_t *stack, size_t &count, size_t idx, uint64_t bits) {
+    if (!bits) return;
+    if (!pending[idx]) stack[count++] = idx;
+    pending[idx] |= bits;
+}
+
+long fillComponent(const WallPlanes &p, SolverBuffers &buffers, size_t idx, uint64_t seed) {
+    uint64_t *pending = buffers.next, *seen = buffers.seen;
+    size_t *stack = buffers.active;
+    size_t count = 0;
+    long cells = 0;
+    handOver(pending, stack, count, idx, seed);
+    while (count) {
+        idx = stack[--count];
+        uint64_t b = pending[idx] & ~seen[idx];
+        pending[idx] = 0;
+        if (!b) continue;
+
+        const uint64_t *v = &p.vertical[idx];
+        uint64_t openEast = ~((v[0] >> 1) | (v[1] << 63));
+        uint64_t openWest = ~v[0];
+        while (true) {
+            uint64_t grown = b | ((b & openEast) << 1) | ((b & openWest) >> 1);
+            if (grown == b) break;
+            b = grown;
+        }
+        b &= ~seen[idx];
+        seen[idx] |= b;
+        cells += popcount64(b);
+
+        int z = (int)(idx / p.stride);
+        handOver(pending, stack, count, idx + 1, (b & openEast) >> 63);
+        handOver(pending, stack, count, idx - 1, (b & openWest) << 63);
+        if (z > 0) handOver(pending, stack, count, idx - p.stride, b & ~p.horizontal[idx]);
+        if (z < p.height - 1) handOver(pending, stack, count, idx + p.stride, b & ~p.horizontal[idx + p.stride]);
+    }
+    return cells;
+}
+
+// Components, dead ends, junctions, branching and the longest shortest path.
+// The longest path is the double-sweep diameter: flood from any cell, then
+// again from the farthest cell found. That is exact for a perfect maze (a
+// tree); the shortcuts ensurePathToDestination() may carve make it a lower
+// bound. It is taken over the largest component.
+void analyzeMaze(const WallPlanes &p, SolverBuffers &buffers, MazeStats &stats) {
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+
+    size_t size = (size_t)p.height * p.stride;
+    uint64_t *seen = buffers.seen;
+    memset(seen, 0, size * sizeof(uint64_t));
+    memset(buffers.next, 0, size * sizeof(uint64_t));
+    stats.components = 0;
+    long largest = 0;
+    int seedX = 0, seedZ = 0;
+    for (int z = 0; z < p.height; z++) {
+        for (int i = 0; i < p.words; i++) {
+            size_t idx = p.at(z, i);
+            uint64_t open;
+            while ((open = p.cellMask[i + 1] & ~seen[idx]) != 0) {
+                uint64_t seed = open & (~open + 1);  // lowest unseen cell
+                long cells = fillComponent(p, buffers, idx, seed);
+                stats.components++;
+                if (cells > largest) {
+                    largest = cells;
+                    seedZ = z;
+                    seedX = i * 64 + popcount64(seed - 1);
+                }
+            }
+        }
+    }
+
+    long hist[5];
+    wallHistogram(p, hist);
+    stats.deadEnds = hist[3];
+    stats.junctions = hist[0] + hist[1];
+    stats.branching = stats.junctions ? (3.0 * hist[0] + 2.0 * hist[1]) / stats.junctions : 0.0;
+
+    int farX = seedX, farZ = seedZ;
+    floodFill(p, buffers, seedX, seedZ, &farX, &farZ);
+    stats.longestPath = floodFill(p, buffers, farX, farZ);
+
+    stats.analysisMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+}
+
+// Per-cell bool versions of the queries above, for the benchmark
+long countOpeningsCells() {
+    long open = 0;
+    for (int x = 0; x < mazeWidth; x++) {
+        for (int z = 0; z < mazeHeight; z++) {
+            if (x + 1 < mazeWidth && !maze[x][z].walls[1]) open++;
+            if (z + 1 < mazeHeight && !maze[x][z].walls[2]) open++;
+        }
+    }
+    return open;
+}
+
+long countDeadEndsCells() {
+    long ends = 0;
+    for (int x = 0; x < mazeWidth; x++) {
+        for (int z = 0; z < mazeHeight; z++) {
+            const Cell &c = maze[x][z];
+            if (c.walls[0] + c.walls[1] + c.walls[2] + c.walls[3] == 3) ends++;
+        }
+    }
+    return ends;
+}
+
+int floodFillCells(int startX, int startZ, long &count, int *lastX = NULL, int *lastZ = NULL) {
+    vector<int> dist((size_t)mazeWidth * mazeHeight, -1);
+    vector<pair<int, int>> queue;
+    queue.push_back(make_pair(startX, startZ));
+    dist[(size_t)startX * mazeHeight + startZ] = 0;
+    int levels = 0;
+    for (size_t head = 0; head < queue.size(); head++) {
+        int x = queue[head].first, z = queue[head].second;
+        int d = dist[(size_t)x * mazeHeight + z];
+        levels = max(levels, d);
+        for (int dir = 0; dir < 4; dir++) {
+            if (maze[x][z].walls[dir]) continue;
+            int nx = x + dx[dir], nz = z + dz[dir];
+            int &nd = dist[(size_t)nx * mazeHeight + nz];
+            if (nd < 0) {
+                nd = d + 1;
+                queue.push_back(make_pair(nx, nz));
+            }
+        }
+    }
+    count = (long)queue.size();
+    if (lastX && lastZ) {
+        *lastX = queue.back().first;
+        *lastZ = queue.back().second;
+    }
+    return levels;
+}
+
+// analyzeMaze() on the bools: BFS per component and per sweep
+void analyzeMazeCells(MazeStats &stats) {
+    vector<char> seen((size_t)mazeWidth * mazeHeight, 0);
+    vector<pair<int, int>> queue;
+    stats.components = 0;
+    long largest = 0;
+    int seedX = 0, seedZ = 0;
+    for (int z = 0; z < mazeHeight; z++) {
+        for (int x = 0; x < mazeWidth; x++) {
+            if (seen[(size_t)x * mazeHeight + z]) continue;
+            stats.components++;
+            queue.clear();
+            queue.push_back(make_pair(x, z));
+            seen[(size_t)x * mazeHeight + z] = 1;
+            for (size_t head = 0; head < queue.size(); head++) {
+                int cx = queue[head].first, cz = queue[head].second;
+                for (int dir = 0; dir < 4; dir++) {
+                    if (maze[cx][cz].walls[dir]) continue;
+                    int nx = cx + dx[dir], nz = cz + dz[dir];
+                    if (!seen[(size_t)nx * mazeHeight + nz]) {
+                        seen[(size_t)nx * mazeHeight + nz] = 1;
+                        queue.push_back(make_pair(nx, nz));
+                    }
+                }
+            }
+            if ((long)queue.size() > largest) {
+                largest = (long)queue.size();
+                seedX = x;
+                seedZ = z;
+            }
+        }
+    }
+
+    long hist[5] = {0, 0, 0, 0, 0};
+    for (int x = 0; x < mazeWidth; x++) {
+        for (int z = 0; z < mazeHeight; z++) {
+            const Cell &c = maze[x][z];
+            hist[c.walls[0] + c.walls[1] + c.walls[2] + c.walls[3]]++;
+        }
+    }
+    stats.deadEnds = hist[3];
+    stats.junctions = hist[0] + hist[1];
+    stats.branching = stats.junctions ? (3.0 * hist[0] + 2.0 * hist[1]) / stats.junctions : 0.0;
+
+    long count;
+    int farX = seedX, farZ = seedZ;
+    floodFillCells(seedX, seedZ, count, &farX, &farZ);
+    stats.longestPath = floodFillCells(farX, farZ, count);
+}
+
+void benchAnalysis() {
+    typedef chrono::steady_clock clock_type;
+    const int sizes[] = {256, 1024, 4096};
+
+    cout << "size  generate_ms  components  dead_ends  junctions  branching  longest_path  planes_ms  cells_ms" << endl;
+    for (int k = 0; k < 3; k++) {
+        int n = sizes[k];
+        mazeWidth = mazeHeight = n;
+        mazeSeed = 7;
+
+        // generateMaze() already runs analyzeMaze() once; time it again alone
+        clock_type::time_point t0 = clock_type::now();
+        generateMaze();
+        clock_type::time_point t1 = clock_type::now();
+
+        MazeStats planes, cells;
+        analyzeMaze(walls, solver, planes);
+        clock_type::time_point t2 = clock_type::now();
+        analyzeMazeCells(cells);
+        clock_type::time_point t3 = clock_type::now();
+
+        if (planes.components != cells.components || planes.deadEnds != cells.deadEnds ||
+            planes.junctions != cells.junctions || planes.longestPath != cells.longestPath) {
+            cout << "mismatch at size " << n << ": longest path " << cells.longestPath << " on the cells" << endl;
+        }
+        cout << n << "  " << chrono::duration<double, milli>(t1 - t0).count() << "  " << planes.components << "  "
+             << planes.deadEnds << "  " << planes.junctions << "  " << planes.branching << "  " << planes.longestPath
+             << "  " << chrono::duration<double, milli>(t2 - t1).count() << "  "
+             << chrono::duration<double, milli>(t3 - t2).count() << endl;
+    }
+}
+
+// Minor page faults of the whole process so far, -1 without getrusage()
+long pageFaults() {
+#ifdef _WIN32
+    return -1;
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+#endif
+}
+
+// The same 4096x4096 maze regenerated over and over. The played maze and
+// backMaze take turns, so each arena spills on its first run and replaces
+// the spills with one block on its second; after that a run should allocate
+// nothing and fault nothing in. Then one build on regenWorker, with the
+// main thread waking every millisecond as a frame loop would.
+void benchRegen() {
+    typedef chrono::steady_clock clock_type;
+    const int RUNS = 8;
+    mazeWidth = mazeHeight = 4096;
+    mazeSeed = 7;
+
+    cout << "run  generate_ms  arena_mb  block_allocations  page_faults" << endl;
+    for (int r = 0; r < RUNS; r++) {
+        long blocks = mazeArena.blockAllocations() + backMaze.arena.blockAllocations(), faults = pageFaults();
+        clock_type::time_point t0 = clock_type::now();
+        generateMaze();
+        double ms = chrono::duration<double, milli>(clock_type::now() - t0).count();
+        cout << r << "  " << ms << "  " << mazeArena.bytesUsed() / 1048576.0 << "  "
+             << mazeArena.blockAllocations() + backMaze.arena.blockAllocations() - blocks << "  "
+             << pageFaults() - faults << endl;
+    }
+
+    int polls = 0;
+    double worstGap = 0;
+    clock_type::time_point t0 = clock_type::now(), last = t0;
+    startRegeneration();
+    while (!regenReady.load(memory_order_acquire)) {
+        this_thread::sleep_for(chrono::milliseconds(1));
+        clock_type::time_point now = clock_type::now();
+        worstGap = max(worstGap, chrono::duration<double, milli>(now - last).count());
+        last = now;
+        polls++;
+    }
+    clock_type::time_point t1 = clock_type::now();
+    regenWorker.join();
+    installMaze(backMaze);
+    clock_type::time_point t2 = clock_type::now();
+    cout << "background  build_ms " << chrono::duration<double, milli>(t1 - t0).count() << "  polls " << polls
+         << "  worst_gap_ms " << worstGap << "  install_ms " << chrono::duration<double, milli>(t2 - t1).count()
+         << endl;
+}
+
+void benchWalls() {
+    typedef chrono::steady_clock clock_type;
+    const int sizes[] = {64, 256, 1024};
+    const int REPS = 20;
+
+#ifdef __AVX2__
+    cout << "dead-end count: AVX2" << endl;
+#else
+    cout << "dead-end count: 64-bit words" << endl;
+#endif
+    cout << "size  build_ms  openings  cells_ms  planes_ms  dead_ends  cells_ms  planes_ms  flood_levels  cells_ms  "
+            "planes_ms"
+         << endl;
+    for (int k = 0; k < 3; k++) {
+        int n = sizes[k];
+        mazeWidth = mazeHeight = n;
+        mazeSeed = 7;
+        generateMaze();
+
+        clock_type::time_point t0 = clock_type::now();
+        for (int r = 0; r < REPS; r++) buildWallPlanes(walls, maze);
+        clock_type::time_point t1 = clock_type::now();
+
+        long openCells = 0, openPlanes = 0, endsCells = 0, endsPlanes = 0;
+        for (int r = 0; r < REPS; r++) openCells += countOpeningsCells();
+        clock_type::time_point t2 = clock_type::now();
+        for (int r = 0; r < REPS; r++) openPlanes += countOpenings(walls);
+        clock_type::time_point t3 = clock_type::now();
+        for (int r = 0; r < REPS; r++) endsCells += countDeadEndsCells();
+        clock_type::time_point t4 = clock_type::now();
+        for (int r = 0; r < REPS; r++) endsPlanes += countDeadEnds(walls);
+        clock_type::time_point t5 = clock_type::now();
+
+        long reachCells = 0;
+        int levelsCells = floodFillCells(1, 1, reachCells);
+        clock_type::time_point t6 = clock_type::now();
+        int levelsPlanes = floodFill(walls, solver, 1, 1);
+        clock_type::time_point t7 = clock_type::now();
+        long reachPlanes = 0;
+        for (size_t i = 0; i < (size_t)n * walls.stride; i++) reachPlanes += popcount64(solver.reached[i]);
+
+        if (openCells != openPlanes || endsCells != endsPlanes || levelsCells != levelsPlanes ||
+            reachCells != reachPlanes) {
+            cout << "mismatch at size " << n << endl;
+        }
+
+        cout << n << "  " << chrono::duration<double, milli>(t1 - t0).count() / REPS << "  " << openPlanes / REPS
+             << "  " << chrono::duration<double, milli>(t2 - t1).count() / REPS << "  "
+             << chrono::duration<double, milli>(t3 - t2).count() / REPS << "  " << endsPlanes / REPS << "  "
+             << chrono::duration<double, milli>(t4 - t3).count() / REPS << "  "
+             << chrono::duration<double, milli>(t5 - t4).count() / REPS << "  " << levelsPlanes << "  "
+             << chrono::duration<double, milli>(t6 - t5).count() << "  "
+             << chrono::duration<double, milli>(t7 - t6).count() << endl;
+    }
+}
+
+void drawMaze(const FrameSnapshot &s, const Viewport &vp) {
+    PROFILE_SCOPE("drawMaze");
     glEnable(GL_CULL_FACE);
     glCullFace(GL_BACK);
 
-    for (int x = 0; x < MAZE_WIDTH; x++) {
-        for (int z = 0; z < MAZE_HEIGHT; z++) {
-            drawCell(x, z);
-        }
+    if (cullCells) {
+        static vector<int> cells;
+        collectVisibleCells(s, raycastCamera(s, vp.width, vp.height), vp.width, cells, cullStats);
+        drawCells(s, &cells);
+
+        profiler().counter("cells", cullStats.submitted);
+        profiler().counter("frustum_culled", cullStats.frustumRejected);
+        profiler().counter("occluded", cullStats.occlusionRejected);
+        profiler().counter("cull_ms", cullStats.traversalMs);
+    } else {
+        drawCells(s, NULL);
     }
 
     // Draw floor
     glColor3f(0.5f, 0.5f, 0.5f);
     glBegin(GL_QUADS);
     glVertex3f(0.0f, 0.0f, 0.0f);
-    glVertex3f(MAZE_WIDTH, 0.0f, 0.0f);
-    glVertex3f(MAZE_WIDTH, 0.0f, MAZE_HEIGHT);
-    glVertex3f(0.0f, 0.0f, MAZE_HEIGHT);
+    glVertex3f(s.width, 0.0f, 0.0f);
+    glVertex3f(s.width, 0.0f, s.height);
+    glVertex3f(0.0f, 0.0f, s.height);
     glEnd();
 
     // Draw ceiling
     glColor3f(0.3f, 0.3f, 0.3f);
     glBegin(GL_QUADS);
     glVertex3f(0.0f, 1.0f, 0.0f);
-    glVertex3f(0.0f, 1.0f, MAZE_HEIGHT);
-    glVertex3f(MAZE_WIDTH, 1.0f, MAZE_HEIGHT);
-    glVertex3f(MAZE_WIDTH, 1.0f, 0.0f);
+    glVertex3f(0.0f, 1.0f, s.height);
+    glVertex3f(s.width, 1.0f, s.height);
+    glVertex3f(s.width, 1.0f, 0.0f);
     glEnd();
 
     // Draw destination marker
     glPushMatrix();
-    glTranslatef(destX + 0.5f, 0.5f, destZ + 0.5f);
+    glTranslatef(s.destX + 0.5f, 0.5f, s.destZ + 0.5f);
     glColor3f(0.0f, 1.0f, 0.0f);  // Green destination
     glutSolidSphere(0.3f, 16, 16);
     glPopMatrix();
 
+    // Other racers
+    glColor3f(1.0f, 0.5f, 0.0f);
+    for (size_t i = 0; i < s.others->size(); i += 3) {
+        glPushMatrix();
+        glTranslatef((*s.others)[i], 0.5f, (*s.others)[i + 1]);
+        glutSolidSphere(0.2f, 12, 12);
+        glPopMatrix();
+    }
+
     glDisable(GL_CULL_FACE);
 }
 
-void drawCell(int x, int z) {
-    float wallHeight = 1.0f;
-
-    if (currentView == BIRD_EYE) {
-        if (x == floor(playerX) && z == floor(playerZ)) {
-            glColor3f(0.7f, 0.7f, 1.0f); 
-        } else if (x == destX && z == destZ) {
-            // Destination cell
-            glColor3f(0.7f, 1.0f, 0.7f);  
-        } else {
-            // Regular cell
-            glColor3f(0.7f, 0.7f, 0.7f);  
-        }
-
-        glBegin(GL_QUADS);
-        glVertex3f(x, 0.01f, z);  
-        glVertex3f(x + 1.0f, 0.01f, z);
-        glVertex3f(x + 1.0f, 0.01f, z + 1.0f);
-        glVertex3f(x, 0.01f, z + 1.0f);
-        glEnd();
+// Occluder from the wall (ax, az)-(bx, bz): every band it fully covers
+// gets the wall's farthest depth within that band, if that is nearer
+void addOccluder(OcclusionBuffer &occ, const RaycastCamera &cam, float ax, float az, float bx, float bz) {
+    const float nearPlane = 0.1f;
+    float da = (ax - cam.x) * cam.dirX + (az - cam.z) * cam.dirZ;
+    float db = (bx - cam.x) * cam.dirX + (bz - cam.z) * cam.dirZ;
+    float la = (ax - cam.x) * cam.rightX + (az - cam.z) * cam.rightZ;
+    float lb = (bx - cam.x) * cam.rightX + (bz - cam.z) * cam.rightZ;
+    if (da < nearPlane && db < nearPlane) return;
+    if (da < nearPlane) {
+        la += (lb - la) * (nearPlane - da) / (db - da);
+        da = nearPlane;
+    } else if (db < nearPlane) {
+        lb += (la - lb) * (nearPlane - db) / (da - db);
+        db = nearPlane;
     }
 
-    if (currentView == BIRD_EYE) {
-        glColor3f(0.0f, 0.0f, 0.8f); 
-    } else {
-        glColor3f(0.0f, 0.7f, 1.0f);  
+    // 1 / depth is linear in screen x along the wall
+    float sa = cam.centerX + la * cam.focal / da, sb = cam.centerX + lb * cam.focal / db;
+    float ia = 1.0f / da, ib = 1.0f / db;
+    if (sa > sb) {
+        swap(sa, sb);
+        swap(ia, ib);
     }
+    if (sb - sa < 1e-6f) return;
+    int first = max(0, (int)ceil(sa / OCCLUSION_BAND));
+    int last = min(occ.bands, (int)floor(sb / OCCLUSION_BAND));
+    float slope = (ib - ia) / (sb - sa);
+    for (int band = first; band < last; band++) {
+        float left = ia + (band * OCCLUSION_BAND - sa) * slope;
+        float right = ia + ((band + 1) * OCCLUSION_BAND - sa) * slope;
+        float depth = 1.0f / min(left, right);
+        if (depth < occ.depth[band]) occ.depth[band] = depth;
+    }
+    for (int block = first / OCCLUSION_BLOCK; block <= (last - 1) / OCCLUSION_BLOCK && block < occ.blocks; block++) {
+        int end = min(occ.bands, (block + 1) * OCCLUSION_BLOCK);
+        float m = 0.0f;
+        for (int band = block * OCCLUSION_BLOCK; band < end; band++) m = max(m, occ.depth[band]);
+        occ.blockMax[block] = m;
+    }
+}
 
-    if (maze[x][z].walls[0]) {
-        glBegin(GL_QUADS);
-        glVertex3f(x, 0.0f, z);
-        glVertex3f(x + 1.0f, 0.0f, z);
-        glVertex3f(x + 1.0f, wallHeight, z);
-        glVertex3f(x, wallHeight, z);
-        glEnd();
-
-        if (currentView == BIRD_EYE) {
-            glColor3f(0.0f, 0.0f, 0.0f);  
-            glLineWidth(2.0f);
-            glBegin(GL_LINES);
-            glVertex3f(x, wallHeight, z);
-            glVertex3f(x + 1.0f, wallHeight, z);
-            glEnd();
-            glLineWidth(1.0f);
+// 0 if the cell is visible, 1 outside the frustum, 2 hidden behind the
+// occluders so far. Depth is linear over the cell, so its nearest point is
+// a corner and the corners bound its screen span.
+int classifyCell(const OcclusionBuffer &occ, const RaycastCamera &cam, int width, int x, int z) {
+    const float nearPlane = 0.1f;
+    float minDepth = 1e30f, minX = 1e30f, maxX = -1e30f;
+    int behind = 0, clipped = 0;
+    for (int k = 0; k < 4; k++) {
+        float px = x + (k & 1) - cam.x, pz = z + (k >> 1) - cam.z;
+        float d = px * cam.dirX + pz * cam.dirZ;
+        if (d <= 0.0f) behind++;
+        if (d < nearPlane) {
+            clipped++;
+            continue;
         }
+        float sx = cam.centerX + (px * cam.rightX + pz * cam.rightZ) * cam.focal / d;
+        minDepth = min(minDepth, d);
+        minX = min(minX, sx);
+        maxX = max(maxX, sx);
     }
-
-    if (maze[x][z].walls[1]) {
-        if (currentView == BIRD_EYE) {
-            glColor3f(0.0f, 0.0f, 0.8f);
-        } else {
-            glColor3f(0.0f, 0.7f, 1.0f);
+    // Lines of sight only leave the eye forwards; a cell reaching into the
+    // near plane may still carry one, so it is kept
+    if (behind == 4) return 1;
+    if (clipped > 0) return 0;
+    if (maxX < 0.0f || minX > width) return 1;
+
+    int first = max(0, (int)floor(minX / OCCLUSION_BAND));
+    int last = min(occ.bands - 1, (int)floor(maxX / OCCLUSION_BAND));
+    for (int band = first; band <= last;) {
+        int block = band / OCCLUSION_BLOCK;
+        if (occ.blockMax[block] < minDepth) {
+            band = (block + 1) * OCCLUSION_BLOCK;
+            continue;
         }
+        if (occ.depth[band] >= minDepth) return 0;
+        band++;
+    }
+    return 2;
+}
 
-        glBegin(GL_QUADS);
-        glVertex3f(x + 1.0f, 0.0f, z);
-        glVertex3f(x + 1.0f, 0.0f, z + 1.0f);
-        glVertex3f(x + 1.0f, wallHeight, z + 1.0f);
-        glVertex3f(x + 1.0f, wallHeight, z);
-        glEnd();
-
-        if (currentView == BIRD_EYE) {
-            glColor3f(0.0f, 0.0f, 0.0f);
-            glLineWidth(2.0f);
-            glBegin(GL_LINES);
-            glVertex3f(x + 1.0f, wallHeight, z);
-            glVertex3f(x + 1.0f, wallHeight, z + 1.0f);
-            glEnd();
-            glLineWidth(1.0f);
-        }
+// Whether the near plane clips part of the wall (ax, az)-(bx, bz) that lies
+// inside the view pyramid, leaving a hole to look through
+bool nearPlaneCuts(const RaycastCamera &cam, float ax, float az, float bx, float bz) {
+    const float nearPlane = 0.1f + 1e-3f;  // with some slack for the GL's rounding
+    float da = (ax - cam.x) * cam.dirX + (az - cam.z) * cam.dirZ;
+    float db = (bx - cam.x) * cam.dirX + (bz - cam.z) * cam.dirZ;
+    float la = (ax - cam.x) * cam.rightX + (az - cam.z) * cam.rightZ;
+    float lb = (bx - cam.x) * cam.rightX + (bz - cam.z) * cam.rightZ;
+    if (max(da, db) <= 0.0f || min(da, db) >= nearPlane) return false;
+
+    // The piece with 0 < depth < nearPlane, against the pyramid's widest
+    // cross-section there
+    float t0 = 0.0f, t1 = 1.0f;
+    if (da != db) {
+        float tz = (0.0f - da) / (db - da), tn = (nearPlane - da) / (db - da);
+        t0 = max(0.0f, min(tz, tn));
+        t1 = min(1.0f, max(tz, tn));
     }
+    float l0 = la + (lb - la) * t0, l1 = la + (lb - la) * t1;
+    float halfWidth = nearPlane * cam.centerX / cam.focal;
+    return min(l0, l1) <= halfWidth && max(l0, l1) >= -halfWidth;
+}
 
-    if (maze[x][z].walls[2]) {
-        if (currentView == BIRD_EYE) {
-            glColor3f(0.0f, 0.0f, 0.8f);
-        } else {
-            glColor3f(0.0f, 0.7f, 1.0f);
+// Cells to draw, roughly nearest first: a breadth-first walk from the
+// player's cell through open walls. Any line of sight passes only through
+// visible cells, so the walk stops at rejected ones. Each submitted cell's
+// walls that face the eye become occluders for the cells after it.
+void collectVisibleCells(const FrameSnapshot &s, const RaycastCamera &cam, int width, vector<int> &cells,
+                         CullStats &stats) {
+    static OcclusionBuffer occ;
+    static vector<uint32_t> mark;  // frame number a cell was queued in
+    static uint32_t frame = 0;
+
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    occ.bands = (width + OCCLUSION_BAND - 1) / OCCLUSION_BAND;
+    occ.blocks = (occ.bands + OCCLUSION_BLOCK - 1) / OCCLUSION_BLOCK;
+    occ.depth.assign(occ.bands, RAYCAST_FAR);
+    occ.blockMax.assign(occ.blocks, RAYCAST_FAR);
+    if (mark.size() != (size_t)s.width * s.height) {
+        mark.assign((size_t)s.width * s.height, 0);
+        frame = 0;
+    }
+    frame++;
+
+    cells.clear();
+    stats.submitted = stats.frustumRejected = stats.occlusionRejected = 0;
+    int startX = min(max((int)floor(cam.x), 0), s.width - 1);
+    int startZ = min(max((int)floor(cam.z), 0), s.height - 1);
+    vector<int> &queue = cells;  // rejected cells are skipped, so the queue becomes the output
+    queue.push_back(startX * s.height + startZ);
+    mark[queue[0]] = frame;
+
+    size_t kept = 0;
+    for (size_t head = 0; head < queue.size(); head++) {
+        int cell = queue[head];
+        int x = cell / s.height, z = cell % s.height;
+        int result = classifyCell(occ, cam, width, x, z);
+        if (result == 1) {
+            stats.frustumRejected++;
+            continue;
         }
+        if (result == 2) {
+            stats.occlusionRejected++;
+            continue;
+        }
+        stats.submitted++;
 
-        glBegin(GL_QUADS);
-        glVertex3f(x, 0.0f, z + 1.0f);
-        glVertex3f(x, wallHeight, z + 1.0f);
-        glVertex3f(x + 1.0f, wallHeight, z + 1.0f);
-        glVertex3f(x + 1.0f, 0.0f, z + 1.0f);
-        glEnd();
-
-        if (currentView == BIRD_EYE) {
-            glColor3f(0.0f, 0.0f, 0.0f);
-            glLineWidth(2.0f);
-            glBegin(GL_LINES);
-            glVertex3f(x, wallHeight, z + 1.0f);
-            glVertex3f(x + 1.0f, wallHeight, z + 1.0f);
-            glEnd();
-            glLineWidth(1.0f);
+        // The near plane cuts holes into walls the eye stands against, so
+        // the walk also passes walls that reach it
+        const Cell &c = (*s.maze)[x][z];
+        for (int dir = 0; dir < 4; dir++) {
+            int nx = x + dx[dir], nz = z + dz[dir];
+            if (nx < 0 || nz < 0 || nx >= s.width || nz >= s.height) continue;
+            bool see = !c.walls[dir];
+            if (!see) {
+                float ax = (float)x + (dir == 1), az = (float)z + (dir == 2);
+                float bx = ax + (dir == 0 || dir == 2), bz = az + (dir == 1 || dir == 3);
+                see = nearPlaneCuts(cam, ax, az, bx, bz);
+            }
+            if (see) {
+                int next = nx * s.height + nz;
+                if (mark[next] != frame) {
+                    mark[next] = frame;
+                    queue.push_back(next);
+                }
+            }
         }
+        // A wall quad faces into its cell and is back-face culled otherwise
+        if (c.walls[0] && cam.z > z) addOccluder(occ, cam, x, z, x + 1.0f, z);
+        if (c.walls[1] && cam.x < x + 1) addOccluder(occ, cam, x + 1.0f, z, x + 1.0f, z + 1.0f);
+        if (c.walls[2] && cam.z < z + 1) addOccluder(occ, cam, x, z + 1.0f, x + 1.0f, z + 1.0f);
+        if (c.walls[3] && cam.x > x) addOccluder(occ, cam, x, z, x, z + 1.0f);
+
+        // Compact in place; head never falls behind kept
+        queue[kept++] = cell;
     }
+    queue.resize(kept);
+    stats.traversalMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+}
 
-    if (maze[x][z].walls[3]) {
-        if (currentView == BIRD_EYE) {
-            glColor3f(0.0f, 0.0f, 0.8f);
-        } else {
-            glColor3f(0.0f, 0.7f, 1.0f);
+// Corners of each wall's quad for a cell at the origin: North, East,
+// South, West
+static const float WALL_CORNERS[4][12] = {
+    {0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0},
+    {1, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 0},
+    {0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 0, 1},
+    {0, 0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1},
+};
+
+// First-person wall quads, submitted with one glDrawArrays per batch
+struct WallBatch {
+    vector<float> vertices;  // x, y, z per corner
+    size_t corners;
+};
+WallBatch wallBatch;
+const int WALL_BATCH_CELLS = 4096;
+
+// Every wall is written, and the end only moves past it if the wall is
+// there, so the loop over the four walls has no branches
+inline void appendCellWalls(WallBatch &b, const Cell &cell, float x, float z) {
+    for (int w = 0; w < 4; w++) {
+        float *v = &b.vertices[b.corners * 3];
+        const float *c = WALL_CORNERS[w];
+        for (int k = 0; k < 12; k += 3) {
+            v[k] = x + c[k];
+            v[k + 1] = c[k + 1];
+            v[k + 2] = z + c[k + 2];
         }
+        b.corners += 4 * cell.walls[w];
+    }
+}
 
-        glBegin(GL_QUADS);
-        glVertex3f(x, 0.0f, z);
-        glVertex3f(x, wallHeight, z);
-        glVertex3f(x, wallHeight, z + 1.0f);
-        glVertex3f(x, 0.0f, z + 1.0f);
-        glEnd();
+void flushWallBatch(WallBatch &b) {
+    if (b.corners == 0) return;
+    glDrawArrays(GL_QUADS, 0, (GLsizei)b.corners);
+    b.corners = 0;
+}
 
-        if (currentView == BIRD_EYE) {
-            glColor3f(0.0f, 0.0f, 0.0f);
-            glLineWidth(2.0f);
-            glBegin(GL_LINES);
-            glVertex3f(x, wallHeight, z);
-            glVertex3f(x, wallHeight, z + 1.0f);
-            glEnd();
-            glLineWidth(1.0f);
-        }
+// The walls of the given cells (x * height + z), or of every cell. The
+// bird's-eye view has its own path in drawMapCells(), so nothing here
+// depends on the view, and color and array state are set once.
+void drawCells(const FrameSnapshot &s, const vector<int> *cells) {
+    WallBatch &b = wallBatch;
+    b.vertices.resize(WALL_BATCH_CELLS * 4 * 12);
+    b.corners = 0;
+
+    glColor3f(0.0f, 0.7f, 1.0f);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, &b.vertices[0]);
+
+    const MazeGrid &grid = *s.maze;
+    size_t count = cells ? cells->size() : (size_t)s.width * s.height;
+    for (size_t i = 0; i < count; i++) {
+        int c = cells ? (*cells)[i] : (int)i;
+        int x = c / s.height, z = c % s.height;
+        appendCellWalls(b, grid[x][z], (float)x, (float)z);
+        if (b.corners > (WALL_BATCH_CELLS - 1) * 16) flushWallBatch(b);
     }
+    flushWallBatch(b);
+
+    glDisableClientState(GL_VERTEX_ARRAY);
 }
 
-void drawPlayer() {
-    if (currentView == BIRD_EYE) {
+void drawPlayer(const FrameSnapshot &s, ViewMode view) {
+    PROFILE_SCOPE("drawPlayer");
+    if (view == BIRD_EYE) {
         glPushMatrix();
-        glTranslatef(playerX, 0.5f, playerZ);
+        glTranslatef(s.playerX, 0.5f, s.playerZ);
 
         glColor3f(1.0f, 0.0f, 0.0f);  
 
@@ -545,15 +1514,15 @@ void drawPlayer() {
         glLineWidth(3.0f);
         glBegin(GL_LINES);
         glVertex3f(0.0f, 0.0f, 0.0f);
-        glVertex3f(cos(playerAngle) * 0.8f, 0.0f, sin(playerAngle) * 0.8f);
+        glVertex3f(cos(s.playerAngle) * 0.8f, 0.0f, sin(s.playerAngle) * 0.8f);
         glEnd();
 
         glBegin(GL_TRIANGLES);
-        float tipX = cos(playerAngle) * 0.8f;
-        float tipZ = sin(playerAngle) * 0.8f;
+        float tipX = cos(s.playerAngle) * 0.8f;
+        float tipZ = sin(s.playerAngle) * 0.8f;
         float arrowSize = 0.2f;
-        float angle1 = playerAngle + 2.5f;
-        float angle2 = playerAngle - 2.5f;
+        float angle1 = s.playerAngle + 2.5f;
+        float angle2 = s.playerAngle - 2.5f;
 
         glVertex3f(tipX, 0.0f, tipZ);
         glVertex3f(tipX - cos(angle1) * arrowSize, 0.0f, tipZ - sin(angle1) * arrowSize);
@@ -565,19 +1534,553 @@ void drawPlayer() {
     }
 }
 
-void keyboard(unsigned char key, int x, int y) {
-    float moveSpeed = 0.1f;
-    float newX, newZ;
+// Raycaster: walls are unit-height segments on grid lines, so one DDA
+// ray per screen column finds every visible wall. The cost depends on
+// the window and the distance to the nearest walls, not the maze size.
 
+// RGBA bytes in memory order, the layout glDrawPixels(GL_RGBA) reads
+inline uint32_t packRGBA(float r, float g, float b) {
+    // Rounded in double like the GL drivers, 0.7f gives 178
+    return (uint32_t)(r * 255.0 + 0.5) | (uint32_t)(g * 255.0 + 0.5) << 8 | (uint32_t)(b * 255.0 + 0.5) << 16 |
+           0xFF000000u;
+}
+
+// What drawMaze() shows with lighting off. Its floor and ceiling quads
+// face away from the eye and are culled, so both are the clear color, as
+// is anything past the far plane.
+const uint32_t RAY_WALL = packRGBA(0.0f, 0.7f, 1.0f);
+const uint32_t RAY_FLOOR = packRGBA(0.0f, 0.0f, 0.0f);
+const uint32_t RAY_CEILING = RAY_FLOOR;
+const uint32_t RAY_BEYOND = RAY_FLOOR;
+
+RaycastCamera raycastCamera(const FrameSnapshot &s, int width, int height) {
+    RaycastCamera cam;
+    cam.x = s.playerX;
+    cam.z = s.playerZ;
+    cam.dirX = cos(s.playerAngle);
+    cam.dirZ = sin(s.playerAngle);
+    cam.rightX = -cam.dirZ;
+    cam.rightZ = cam.dirX;
+    cam.focal = 0.5f * height / tan(30.0f * (float)M_PI / 180.0f);
+    cam.centerX = 0.5f * width;
+    cam.centerY = 0.5f * height;
+    return cam;
+}
+
+// Ray through image-plane offset t (pixels / focal): distance along the
+// view direction to the first wall, RAYCAST_FAR if there is none closer.
+// Crossing x = X tests vertical bit X of the row, crossing z = Z tests
+// horizontal row Z; the borders are walls, so the ray never leaves.
+float castRay(const WallPlanes &p, const RaycastCamera &cam, float t) {
+    float rx = cam.dirX + cam.rightX * t;
+    float rz = cam.dirZ + cam.rightZ * t;
+    int mapX = (int)floor(cam.x);
+    int mapZ = (int)floor(cam.z);
+    float deltaX = rx != 0.0f ? fabs(1.0f / rx) : 1e30f;
+    float deltaZ = rz != 0.0f ? fabs(1.0f / rz) : 1e30f;
+    int stepX = rx < 0.0f ? -1 : 1;
+    int stepZ = rz < 0.0f ? -1 : 1;
+    float sideX = (rx < 0.0f ? cam.x - mapX : mapX + 1.0f - cam.x) * deltaX;
+    float sideZ = (rz < 0.0f ? cam.z - mapZ : mapZ + 1.0f - cam.z) * deltaZ;
+
+    for (;;) {
+        if (sideX < sideZ) {
+            if (sideX > RAYCAST_FAR) return RAYCAST_FAR;
+            int bx = mapX + (stepX > 0);
+            if (p.vertical[p.at(mapZ, bx >> 6)] >> (bx & 63) & 1) return sideX;
+            mapX += stepX;
+            sideX += deltaX;
+        } else {
+            if (sideZ > RAYCAST_FAR) return RAYCAST_FAR;
+            int bz = mapZ + (stepZ > 0);
+            if (p.horizontal[p.at(bz, mapX >> 6)] >> (mapX & 63) & 1) return sideZ;
+            mapZ += stepZ;
+            sideZ += deltaZ;
+        }
+    }
+}
+
+// First wall row and first ceiling row of a column, bottom up; a row is
+// covered when its center is, like the rasterizer
+inline void wallRows(const RaycastCamera &cam, float dist, int height, int &bottom, int &top) {
+    float half = 0.5f * cam.focal / max(dist, 1e-3f);
+    bottom = (int)ceil(cam.centerY - half - 0.5f);
+    top = (int)ceil(cam.centerY + half - 0.5f);
+    bottom = min(max(bottom, 0), height);
+    top = min(max(top, 0), height);
+}
+
+void castColumn(RaycastFrame &frame, const WallPlanes &p, const RaycastCamera &cam, int x) {
+    float dist = castRay(p, cam, (x + 0.5f - cam.centerX) / cam.focal);
+    frame.depth[x] = dist;
+
+    int bottom, top;
+    wallRows(cam, dist, frame.height, bottom, top);
+    uint32_t wall = dist < RAYCAST_FAR ? RAY_WALL : RAY_BEYOND;
+    uint32_t *px = &frame.pixels[x];
+    int y = 0;
+    for (; y < bottom; y++) px[(size_t)y * frame.width] = RAY_FLOOR;
+    for (; y < top; y++) px[(size_t)y * frame.width] = wall;
+    for (; y < frame.height; y++) px[(size_t)y * frame.width] = RAY_CEILING;
+}
+
+#ifdef __SSE2__
+// castRay() for four adjacent columns in lockstep. The DDA state and the
+// step choice are vectors; the wall bits are fetched per lane, SSE2 has
+// no gather. Neighbouring rays mostly reach the same wall, so few lanes
+// sit idle. Each row of the packet is then one 16-byte store.
+void castPacket(RaycastFrame &frame, const WallPlanes &p, const RaycastCamera &cam, int x0) {
+    __m128 t = _mm_setr_ps(x0 + 0.5f, x0 + 1.5f, x0 + 2.5f, x0 + 3.5f);
+    t = _mm_mul_ps(_mm_sub_ps(t, _mm_set1_ps(cam.centerX)), _mm_set1_ps(1.0f / cam.focal));
+    __m128 rx = _mm_add_ps(_mm_set1_ps(cam.dirX), _mm_mul_ps(_mm_set1_ps(cam.rightX), t));
+    __m128 rz = _mm_add_ps(_mm_set1_ps(cam.dirZ), _mm_mul_ps(_mm_set1_ps(cam.rightZ), t));
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128 far = _mm_set1_ps(RAYCAST_FAR);
+    __m128 deltaX = _mm_min_ps(_mm_and_ps(_mm_div_ps(one, rx), absMask), _mm_set1_ps(1e30f));
+    __m128 deltaZ = _mm_min_ps(_mm_and_ps(_mm_div_ps(one, rz), absMask), _mm_set1_ps(1e30f));
+    __m128 negX = _mm_cmplt_ps(rx, zero);
+    __m128 negZ = _mm_cmplt_ps(rz, zero);
+    __m128i stepX = _mm_or_si128(_mm_castps_si128(negX), _mm_set1_epi32(1));  // -1 or 1
+    __m128i stepZ = _mm_or_si128(_mm_castps_si128(negZ), _mm_set1_epi32(1));
+
+    int cellX = (int)floor(cam.x), cellZ = (int)floor(cam.z);
+    __m128i mapX = _mm_set1_epi32(cellX);
+    __m128i mapZ = _mm_set1_epi32(cellZ);
+    __m128 fracX = _mm_set1_ps(cam.x - cellX), fracZ = _mm_set1_ps(cam.z - cellZ);
+    __m128 sideX = _mm_mul_ps(_mm_or_ps(_mm_and_ps(negX, fracX), _mm_andnot_ps(negX, _mm_sub_ps(one, fracX))), deltaX);
+    __m128 sideZ = _mm_mul_ps(_mm_or_ps(_mm_and_ps(negZ, fracZ), _mm_andnot_ps(negZ, _mm_sub_ps(one, fracZ))), deltaZ);
+
+    __m128 dist = far;
+    __m128 active = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (;;) {
+        __m128 stepsX = _mm_cmplt_ps(sideX, sideZ);
+        __m128 next = _mm_or_ps(_mm_and_ps(stepsX, sideX), _mm_andnot_ps(stepsX, sideZ));
+        active = _mm_andnot_ps(_mm_cmpgt_ps(next, far), active);
+        int lanes = _mm_movemask_ps(active);
+        if (lanes == 0) break;
+
+        int mx[4], mz[4];
+        _mm_storeu_si128((__m128i *)mx, mapX);
+        _mm_storeu_si128((__m128i *)mz, mapZ);
+        int xs = _mm_movemask_ps(stepsX), sx = _mm_movemask_ps(negX), sz = _mm_movemask_ps(negZ);
+        int hits = 0;
+        for (int i = 0; i < 4; i++) {
+            if (!(lanes >> i & 1)) continue;
+            uint64_t bit;
+            if (xs >> i & 1) {
+                int bx = mx[i] + !(sx >> i & 1);
+                bit = p.vertical[p.at(mz[i], bx >> 6)] >> (bx & 63);
+            } else {
+                bit = p.horizontal[p.at(mz[i] + !(sz >> i & 1), mx[i] >> 6)] >> (mx[i] & 63);
+            }
+            hits |= (int)(bit & 1) << i;
+        }
+        __m128 hit = _mm_castsi128_ps(_mm_setr_epi32(-(hits & 1), -(hits >> 1 & 1), -(hits >> 2 & 1), -(hits >> 3 & 1)));
+        dist = _mm_or_ps(_mm_and_ps(hit, next), _mm_andnot_ps(hit, dist));
+        active = _mm_andnot_ps(hit, active);
+
+        __m128i moveX = _mm_castps_si128(stepsX);
+        mapX = _mm_add_epi32(mapX, _mm_and_si128(moveX, stepX));
+        mapZ = _mm_add_epi32(mapZ, _mm_andnot_si128(moveX, stepZ));
+        sideX = _mm_add_ps(sideX, _mm_and_ps(stepsX, deltaX));
+        sideZ = _mm_add_ps(sideZ, _mm_andnot_ps(stepsX, deltaZ));
+    }
+    _mm_storeu_ps(&frame.depth[x0], dist);
+
+    int bottom[4], top[4];
+    uint32_t wall[4];
+    for (int i = 0; i < 4; i++) {
+        wallRows(cam, frame.depth[x0 + i], frame.height, bottom[i], top[i]);
+        wall[i] = frame.depth[x0 + i] < RAYCAST_FAR ? RAY_WALL : RAY_BEYOND;
+    }
+    __m128i bottomV = _mm_loadu_si128((const __m128i *)bottom);
+    __m128i topV = _mm_loadu_si128((const __m128i *)top);
+    __m128i wallV = _mm_loadu_si128((const __m128i *)wall);
+    __m128i floorV = _mm_set1_epi32((int)RAY_FLOOR);
+    __m128i ceilingV = _mm_set1_epi32((int)RAY_CEILING);
+    for (int y = 0; y < frame.height; y++) {
+        __m128i row = _mm_set1_epi32(y);
+        __m128i below = _mm_cmpgt_epi32(bottomV, row);
+        __m128i inWall = _mm_cmpgt_epi32(topV, row);
+        __m128i upper = _mm_or_si128(_mm_and_si128(inWall, wallV), _mm_andnot_si128(inWall, ceilingV));
+        __m128i c = _mm_or_si128(_mm_and_si128(below, floorV), _mm_andnot_si128(below, upper));
+        _mm_storeu_si128((__m128i *)&frame.pixels[(size_t)y * frame.width + x0], c);
+    }
+}
+#endif
+
+void castColumns(RaycastFrame &frame, const WallPlanes &p, const RaycastCamera &cam, int begin, int end,
+                 bool simd) {
+    int x = begin;
+#ifdef __SSE2__
+    if (simd) {
+        for (; x + 4 <= end; x += 4) castPacket(frame, p, cam, x);
+    }
+#endif
+    for (; x < end; x++) castColumn(frame, p, cam, x);
+}
+
+// Destination sphere as a flat disc, hidden where a column's wall is nearer
+void castMarker(RaycastFrame &frame, const RaycastCamera &cam, float x, float z, float radius, uint32_t color) {
+    float relX = x - cam.x, relZ = z - cam.z;
+    float depth = relX * cam.dirX + relZ * cam.dirZ;
+    if (depth < 0.1f + radius || depth > RAYCAST_FAR) return;
+
+    float cx = cam.centerX + (relX * cam.rightX + relZ * cam.rightZ) * cam.focal / depth;
+    float r = radius * cam.focal / sqrt(depth * depth - radius * radius);
+    int x0 = max(0, (int)ceil(cx - r - 0.5f)), x1 = min(frame.width, (int)ceil(cx + r - 0.5f));
+    for (int col = x0; col < x1; col++) {
+        if (frame.depth[col] < depth) continue;
+        float ox = col + 0.5f - cx;
+        float h = sqrt(max(r * r - ox * ox, 0.0f));
+        int y0 = max(0, (int)ceil(cam.centerY - h - 0.5f)), y1 = min(frame.height, (int)ceil(cam.centerY + h - 0.5f));
+        for (int y = y0; y < y1; y++) frame.pixels[(size_t)y * frame.width + col] = color;
+    }
+}
+
+// Column strips on worker threads, four-column aligned for castPacket()
+void castFrame(RaycastFrame &frame, const FrameSnapshot &s, const RaycastCamera &cam, int width, int height,
+               int threads, bool simd) {
+    if (frame.width != width || frame.height != height) {
+        frame.width = width;
+        frame.height = height;
+        frame.pixels.assign((size_t)width * height, 0);
+        frame.depth.assign(width, RAYCAST_FAR);
+    }
+
+    int n = max(1, min(threads, width / 64));
+    int chunk = ((width + n - 1) / n + 3) & ~3;
+    const WallPlanes &p = *s.walls;
+    workers.run(n, [&](int w) {
+        int begin = w * chunk;
+        int end = min(width, begin + chunk);
+        if (begin < end) castColumns(frame, p, cam, begin, end, simd);
+    });
+
+    castMarker(frame, cam, s.destX + 0.5f, s.destZ + 0.5f, 0.3f, packRGBA(0.0f, 1.0f, 0.0f));
+    for (size_t i = 0; i < s.others->size(); i += 3) {
+        castMarker(frame, cam, (*s.others)[i], (*s.others)[i + 1], 0.2f, packRGBA(1.0f, 0.5f, 0.0f));
+    }
+}
+
+void drawRaycast(const FrameSnapshot &s, const Viewport &vp) {
+    PROFILE_SCOPE("drawRaycast");
+    RaycastCamera cam = raycastCamera(s, vp.width, vp.height);
+    castFrame(raycastFrame, s, cam, vp.width, vp.height, (int)workerCount);
+
+    // One blit at the viewport's lower-left corner
+    glPushAttrib(GL_ENABLE_BIT);
+    glDisable(GL_DEPTH_TEST);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+    glRasterPos2f(-1.0f, -1.0f);
+    glDrawPixels(raycastFrame.width, raycastFrame.height, GL_RGBA, GL_UNSIGNED_BYTE, &raycastFrame.pixels[0]);
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopAttrib();
+}
+
+// Frames of 800x600 over a full turn, per maze size. drawMaze() needs a
+// GL context; the harness times it next to drawRaycast().
+void benchRaycast() {
+    typedef chrono::steady_clock clock_type;
+    const int sizes[] = {10, 256, 1024};
+    const int FRAMES = 100;
+    const int W = 800, H = 600;
+    RaycastFrame frame;
+    frame.width = frame.height = 0;
+
+    cout << workerCount << " threads" << endl;
+    cout << "size  scalar_ms  simd_ms  simd_threads_ms  column_mismatches" << endl;
+    for (int k = 0; k < 3; k++) {
+        int n = sizes[k];
+        mazeWidth = mazeHeight = n;
+        destX = destZ = n - 2;
+        mazeSeed = 7;
+        generateMaze();
+        playerX = playerZ = 1.5f;
+
+        double ms[3];
+        long mismatches = 0;
+        vector<float> scalarDepth;
+        for (int mode = 0; mode < 3; mode++) {
+            clock_type::time_point t0 = clock_type::now();
+            for (int f = 0; f < FRAMES; f++) {
+                playerAngle = f * 2.0f * (float)M_PI / FRAMES;
+                FrameSnapshot snap = takeSnapshot();
+                castFrame(frame, snap, raycastCamera(snap, W, H), W, H, mode == 2 ? (int)workerCount : 1, mode != 0);
+                if (f == FRAMES / 3) {
+                    if (mode == 0) {
+                        scalarDepth = frame.depth;
+                    } else {
+                        for (int x = 0; x < W; x++) mismatches += fabs(frame.depth[x] - scalarDepth[x]) > 1e-3f;
+                    }
+                }
+            }
+            ms[mode] = chrono::duration<double, milli>(clock_type::now() - t0).count() / FRAMES;
+        }
+        cout << n << "  " << ms[0] << "  " << ms[1] << "  " << ms[2] << "  " << mismatches << endl;
+    }
+}
+
+// Culling walk alone, 800 columns, a full turn in the middle of mazes of
+// growing size. Frame times with and without it come from the harness.
+void benchOcclusion() {
+    typedef chrono::steady_clock clock_type;
+    const int sizes[] = {64, 256, 1024};
+    const int FRAMES = 100;
+    vector<int> cells;
+    CullStats stats;
+
+    cout << "size  cells  submitted  frustum_culled  occluded  walk_ms" << endl;
+    for (int k = 0; k < 3; k++) {
+        int n = sizes[k];
+        mazeWidth = mazeHeight = n;
+        destX = destZ = n - 2;
+        mazeSeed = 7;
+        generateMaze();
+        playerX = playerZ = n / 2 + 0.5f;
+
+        double submitted = 0, frustum = 0, occluded = 0;
+        clock_type::time_point t0 = clock_type::now();
+        for (int f = 0; f < FRAMES; f++) {
+            playerAngle = f * 2.0f * (float)M_PI / FRAMES;
+            FrameSnapshot snap = takeSnapshot();
+            collectVisibleCells(snap, raycastCamera(snap, 800, 600), 800, cells, stats);
+            submitted += stats.submitted;
+            frustum += stats.frustumRejected;
+            occluded += stats.occlusionRejected;
+        }
+        double ms = chrono::duration<double, milli>(clock_type::now() - t0).count() / FRAMES;
+        cout << n << "  " << (long)n * n << "  " << submitted / FRAMES << "  " << frustum / FRAMES << "  "
+             << occluded / FRAMES << "  " << ms << endl;
+    }
+}
+
+// p in [0, 1] of the samples, 0 if there are none, e.g. when no client
+// got a tick through
+double percentile(vector<double> samples, double p) {
+    if (samples.empty()) return 0.0;
+    sort(samples.begin(), samples.end());
+    return samples[(size_t)(p * (samples.size() - 1))];
+}
+
+// Bots racing through a host on loopback, per number of clients. Bytes per
+// client per tick each way after joining, next to what three floats per
+// player would cost, and the delay from the start of a host tick to its
+// arrival at each client, all clients served by this one thread.
+void benchNet() {
+    typedef chrono::steady_clock clock_type;
+    const int counts[] = {2, 4, 16, 64, 256};
+    const int TICKS = 300;
+    mazeWidth = mazeHeight = 64;
+    destX = destZ = 62;
+    mazeSeed = 7;
+    generateMaze();
+    NetMaze m = packMaze();
+    mt19937 gen(1);
+    uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    cout << "clients  join_bytes  down_bytes  up_bytes  raw_bytes  p50_us  p99_us  tick_ms" << endl;
+    for (int k = 0; k < 5; k++) {
+        int n = counts[k];
+        NetHost host;
+        if (!host.listen(0)) {
+            cout << "Cannot listen" << endl;
+            return;
+        }
+        host.setMaze(m);
+        vector<NetClient> clients(n);
+        for (int i = 0; i < n; i++) {
+            if (!clients[i].connect(host.port())) {
+                cout << "Cannot connect client " << i << endl;
+                return;
+            }
+        }
+        for (int joined = 0; joined < n;) {
+            host.update();
+            joined = 0;
+            for (int i = 0; i < n; i++) {
+                clients[i].update();
+                joined += clients[i].id >= 0 && clients[i].maze.width == m.width;
+            }
+        }
+
+        // Four in five bots walk each tick, the rest stand still
+        vector<float> x(n, 1.5f), z(n, 1.5f), angle(n);
+        for (int i = 0; i < n; i++) angle[i] = unit(gen) * 2.0f * (float)M_PI;
+        long join = host.bytesSent / n, down = host.bytesSent, up = 0;
+        for (int i = 0; i < n; i++) up -= clients[i].connection().bytesSent;
+
+        vector<double> latency;
+        clock_type::time_point start = clock_type::now();
+        for (int t = 0; t < TICKS; t++) {
+            for (int i = 0; i < n; i++) {
+                if (unit(gen) < 0.8f) {
+                    angle[i] += (unit(gen) - 0.5f) * 0.3f;
+                    x[i] = min(max(x[i] + cos(angle[i]) * 0.1f, 0.5f), mazeWidth - 0.5f);
+                    z[i] = min(max(z[i] + sin(angle[i]) * 0.1f, 0.5f), mazeHeight - 0.5f);
+                }
+                clients[i].send(netQuantize(x[i], z[i], angle[i]));
+            }
+
+            clock_type::time_point t0 = clock_type::now();
+            uint32_t before = host.lastTick();
+            host.update();
+            if (host.lastTick() == before) continue;  // nobody moved
+            for (int i = 0; i < n; i++) {
+                while (clients[i].tick != host.lastTick()) clients[i].update();
+                latency.push_back(chrono::duration<double, micro>(clock_type::now() - t0).count());
+            }
+        }
+        double tickMs = chrono::duration<double, milli>(clock_type::now() - start).count() / TICKS;
+
+        down = host.bytesSent - down;
+        for (int i = 0; i < n; i++) up += clients[i].connection().bytesSent;
+        cout << n << "  " << join << "  " << (double)down / TICKS / n << "  " << (double)up / TICKS / n << "  "
+             << n * 12 << "  " << percentile(latency, 0.5) << "  " << percentile(latency, 0.99) << "  " << tickMs
+             << endl;
+    }
+}
+
+// A new maze. It is built on regenWorker while play goes on in this one,
+// or is ready already after a win. In a race the host picks it and everyone
+// restarts with it.
+void restartGame() {
+    if (netClient || restartPending) return;
+    restartPending = true;
+    startRegeneration();
+    pollRegeneration(0);
+}
+
+// Installs the new maze once regenWorker is done, between two frames
+void pollRegeneration(int value) {
+    if (!restartPending) return;  // generateMaze() or loadMaze() came first
+    if (!regenReady.load(memory_order_acquire)) {
+        glutTimerFunc(REGEN_POLL_MS, pollRegeneration, value);
+        return;
+    }
+    regenWorker.join();
+    restartPending = false;
+    installMaze(backMaze);
+    gameWon = false;
+    raceWinner = -1;
+    if (netHost) netHost->setMaze(packMaze());
+    glutPostRedisplay();
+}
+
+NetMaze packMaze() {
+    NetMaze m;
+    m.seed = mazeSeedUsed;
+    m.width = mazeWidth;
+    m.height = mazeHeight;
+    m.destX = destX;
+    m.destZ = destZ;
+    packMazeWalls(maze, mazeWidth, mazeHeight, m.walls);
+    return m;
+}
+
+// The host's maze replaces ours, as generateMaze() would
+void loadMaze(const NetMaze &m) {
+    waitForRegeneration();
+    MazeBuffer &b = backMaze;
+    b.width = m.width;
+    b.height = m.height;
+    layoutMaze(b);
+    b.destX = m.destX;
+    b.destZ = m.destZ;
+    b.seed = m.seed;
+
+    size_t vertical = (size_t)(b.height + 1) * b.width;
+    for (int x = 0; x < b.width; x++) {
+        for (int z = 0; z < b.height; z++) {
+            size_t north = (size_t)z * b.width + x, west = vertical + (size_t)z * (b.width + 1) + x;
+            size_t south = north + b.width, east = west + 1;
+            Cell &c = b.grid[x][z];
+            c.visited = true;
+            c.walls[0] = m.walls[north >> 3] >> (north & 7) & 1;
+            c.walls[1] = m.walls[east >> 3] >> (east & 7) & 1;
+            c.walls[2] = m.walls[south >> 3] >> (south & 7) & 1;
+            c.walls[3] = m.walls[west >> 3] >> (west & 7) & 1;
+        }
+    }
+    buildWallPlanes(b.walls, b.grid);
+    analyzeMaze(b.walls, b.solver, b.stats);
+    installMaze(b);
+
+    gameWon = false;
+    raceWinner = -1;
+}
+
+// Exchanges positions with the other racers every NET_TICK_MS. Frames are
+// only requested when something visible arrived.
+void netTick(int value) {
+    NetPlayer self = netQuantize(playerX, playerZ, playerAngle);
+    const vector<NetPlayer> *players;
+    int events, winner;
+    if (netHost) {
+        netHost->players[0] = self;
+        events = netHost->update();
+        players = &netHost->players;
+        winner = netHost->winner;
+    } else {
+        events = netClient->update();
+        if (events & NET_EVENT_MAZE) {
+            loadMaze(netClient->maze);
+            self = netQuantize(playerX, playerZ, playerAngle);
+        }
+        netClient->send(self);
+        if (!netClient->connected()) {
+            cout << "Lost the connection to the host" << endl;
+            delete netClient;
+            netClient = NULL;
+            remotePlayers.clear();
+            glutPostRedisplay();
+            return;
+        }
+        netId = netClient->id;
+        players = &netClient->players;
+        winner = netClient->winner;
+    }
+
+    if (events & NET_EVENT_WINNER) {
+        raceWinner = winner;
+        gameWon = true;
+    }
+
+    vector<float> others;
+    for (size_t i = 0; i < players->size(); i++) {
+        const NetPlayer &p = (*players)[i];
+        if ((int)i == netId || !p.active) continue;
+        others.push_back(netPlayerX(p));
+        others.push_back(netPlayerZ(p));
+        others.push_back(netPlayerAngle(p));
+    }
+    if (others != remotePlayers || (events & (NET_EVENT_MAZE | NET_EVENT_WINNER))) {
+        remotePlayers.swap(others);
+        glutPostRedisplay();
+    }
+    glutTimerFunc(NET_TICK_MS, netTick, value);
+}
+
+void keyboard(unsigned char key, int x, int y) {
     // Handle game won state
     if (gameWon) {
         switch (key) {
             case 'r':
             case 'R':
                 // Reset the game
-                gameWon = false;
-                initMaze();
-                generateMaze();
+                restartGame();
+                glutPostRedisplay();
                 break;
 
             case 'q':
@@ -599,123 +2102,22 @@ void keyboard(unsigned char key, int x, int y) {
 
         case 'w':
         case 'W':
-            // Move forward
-            newX = playerX + cos(playerAngle) * moveSpeed;
-            newZ = playerZ + sin(playerAngle) * moveSpeed;
-            if (newX > 0 && newX < MAZE_WIDTH && newZ > 0 && newZ < MAZE_HEIGHT) {
-                int cellX = floor(playerX);
-                int cellZ = floor(playerZ);
-                int newCellX = floor(newX);
-                int newCellZ = floor(newZ);
-
-                if (newCellX != cellX) {
-                    int wallDir = (newCellX > cellX) ? 1 : 3;
-                    if (maze[cellX][cellZ].walls[wallDir]) {
-                        newX = playerX;
-                    }
-                }
-
-                if (newCellZ != cellZ) {
-                    int wallDir = (newCellZ > cellZ) ? 2 : 0;
-                    if (maze[cellX][cellZ].walls[wallDir]) {
-                        newZ = playerZ;
-                    }
-                }
-
-                playerX = newX;
-                playerZ = newZ;
-            }
+            input.forward++;
             break;
 
         case 's':
         case 'S':
-            // Move backward
-            newX = playerX - cos(playerAngle) * moveSpeed;
-            newZ = playerZ - sin(playerAngle) * moveSpeed;
-            // Check for collision
-            if (newX > 0 && newX < MAZE_WIDTH && newZ > 0 && newZ < MAZE_HEIGHT) {
-                int cellX = floor(playerX);
-                int cellZ = floor(playerZ);
-                int newCellX = floor(newX);
-                int newCellZ = floor(newZ);
-
-                if (newCellX != cellX) {
-                    int wallDir = (newCellX > cellX) ? 1 : 3;
-                    if (maze[cellX][cellZ].walls[wallDir]) {
-                        newX = playerX;
-                    }
-                }
-
-                if (newCellZ != cellZ) {
-                    int wallDir = (newCellZ > cellZ) ? 2 : 0;
-                    if (maze[cellX][cellZ].walls[wallDir]) {
-                        newZ = playerZ;
-                    }
-                }
-
-                playerX = newX;
-                playerZ = newZ;
-            }
+            input.forward--;
             break;
 
         case 'a':
         case 'A':
-            // Strafe left
-            newX = playerX + cos(playerAngle - M_PI / 2) * moveSpeed;
-            newZ = playerZ + sin(playerAngle - M_PI / 2) * moveSpeed;
-            if (newX > 0 && newX < MAZE_WIDTH && newZ > 0 && newZ < MAZE_HEIGHT) {
-                int cellX = floor(playerX);
-                int cellZ = floor(playerZ);
-                int newCellX = floor(newX);
-                int newCellZ = floor(newZ);
-
-                if (newCellX != cellX) {
-                    int wallDir = (newCellX > cellX) ? 1 : 3;
-                    if (maze[cellX][cellZ].walls[wallDir]) {
-                        newX = playerX;
-                    }
-                }
-
-                if (newCellZ != cellZ) {
-                    int wallDir = (newCellZ > cellZ) ? 2 : 0;
-                    if (maze[cellX][cellZ].walls[wallDir]) {
-                        newZ = playerZ;
-                    }
-                }
-
-                playerX = newX;
-                playerZ = newZ;
-            }
+            input.strafe--;
             break;
 
         case 'd':
         case 'D':
-            // Strafe right
-            newX = playerX + cos(playerAngle + M_PI / 2) * moveSpeed;
-            newZ = playerZ + sin(playerAngle + M_PI / 2) * moveSpeed;
-            if (newX > 0 && newX < MAZE_WIDTH && newZ > 0 && newZ < MAZE_HEIGHT) {
-                int cellX = floor(playerX);
-                int cellZ = floor(playerZ);
-                int newCellX = floor(newX);
-                int newCellZ = floor(newZ);
-
-                if (newCellX != cellX) {
-                    int wallDir = (newCellX > cellX) ? 1 : 3;
-                    if (maze[cellX][cellZ].walls[wallDir]) {
-                        newX = playerX;
-                    }
-                }
-
-                if (newCellZ != cellZ) {
-                    int wallDir = (newCellZ > cellZ) ? 2 : 0;
-                    if (maze[cellX][cellZ].walls[wallDir]) {
-                        newZ = playerZ;
-                    }
-                }
-
-                playerX = newX;
-                playerZ = newZ;
-            }
+            input.strafe++;
             break;
 
         case 'f':
@@ -730,12 +2132,42 @@ void keyboard(unsigned char key, int x, int y) {
             currentView = BIRD_EYE;
             break;
 
+        case 'c':
+        case 'C':
+            firstPersonRenderer = firstPersonRenderer == RENDER_GEOMETRY ? RENDER_RAYCAST : RENDER_GEOMETRY;
+            break;
+
+        case 'v':
+        case 'V':
+            layout = layout == LAYOUT_SINGLE ? LAYOUT_SPLIT : layout == LAYOUT_SPLIT ? LAYOUT_PIP : LAYOUT_SINGLE;
+            break;
+
+        case 'o':
+        case 'O':
+            cullCells = !cullCells;
+            break;
+
+        case 'm':
+        case 'M':
+            mouseLook = !mouseLook;
+            lastMouseX = -1;
+            glutSetCursor(mouseLook ? GLUT_CURSOR_NONE : GLUT_CURSOR_INHERIT);
+            break;
+
+        case 'p':
+        case 'P':
+            showProfile = !showProfile;
+            break;
+
+        case 't':
+        case 'T':
+            if (profiler().writeChromeTrace("Hw_04_trace.json")) cout << "Wrote Hw_04_trace.json" << endl;
+            break;
+
         case 'r':
         case 'R':
             // Reset/regenerate maze
-            gameWon = false;
-            initMaze();
-            generateMaze();
+            restartGame();
             break;
     }
 
@@ -747,48 +2179,17 @@ void mouseFunc(int button, int state, int x, int y) {
         switch (button) {
             case GLUT_LEFT_BUTTON:
                 // Turn the user 90 degrees to the left
-                playerAngle -= M_PI / 2.0f;
+                input.turn -= M_PI / 2.0f;
                 break;
 
             case GLUT_RIGHT_BUTTON:
                 // Turn the user 90 degrees to the right
-                playerAngle += M_PI / 2.0f;
+                input.turn += M_PI / 2.0f;
                 break;
 
             case GLUT_MIDDLE_BUTTON:
                 // Move the user forward
-                float newX = playerX + cos(playerAngle) * 0.5f;
-                float newZ = playerZ + sin(playerAngle) * 0.5f;
-
-                // Check for collision
-                if (newX > 0 && newX < MAZE_WIDTH && newZ > 0 && newZ < MAZE_HEIGHT) {
-                    int cellX = floor(playerX);
-                    int cellZ = floor(playerZ);
-                    int newCellX = floor(newX);
-                    int newCellZ = floor(newZ);
-
-                    // Check if we're crossing a wall
-                    bool canMove = true;
-
-                    if (newCellX != cellX) {
-                        int wallDir = (newCellX > cellX) ? 1 : 3;
-                        if (maze[cellX][cellZ].walls[wallDir]) {
-                            canMove = false;
-                        }
-                    }
-
-                    if (newCellZ != cellZ) {
-                        int wallDir = (newCellZ > cellZ) ? 2 : 0;
-                        if (maze[cellX][cellZ].walls[wallDir]) {
-                            canMove = false;
-                        }
-                    }
-
-                    if (canMove) {
-                        playerX = newX;
-                        playerZ = newZ;
-                    }
-                }
+                input.lunges++;
                 break;
         }
 
@@ -796,196 +2197,174 @@ void mouseFunc(int button, int state, int x, int y) {
     }
 }
 
-void drawMiniMap() {
-    // Save current matrices
+// Passive and dragged motion both turn the player while mouse-look is on
+void mouseMotion(int x, int y) {
+    if (!mouseLook || gameWon) {
+        lastMouseX = -1;
+        return;
+    }
+
+    if (lastMouseX >= 0 && x != lastMouseX) {
+        input.turn += (x - lastMouseX) * MOUSE_SENSITIVITY;
+        glutPostRedisplay();
+    }
+    lastMouseX = x;
+
+    // The warp's own motion event lands on the center and adds nothing
+    int centerX = windowWidth / 2, centerY = windowHeight / 2;
+    if (abs(x - centerX) > windowWidth / 4 || abs(y - centerY) > windowHeight / 4) {
+        glutWarpPointer(centerX, centerY);
+        lastMouseX = centerX;
+    }
+}
+
+// Everything accumulated since the last frame, as one maze_core.h tick
+void applyInput() {
+    InputState in = input;
+    memset(&input, 0, sizeof(input));
+    if (gameWon) return;
+    applyMazeInput(maze, mazeWidth, mazeHeight, playerX, playerZ, playerAngle, in);
+}
+
+// Colors of one map rendering; the minimap and the bird's-eye view differ
+struct MapStyle {
+    float background[3];
+    float floor[3];
+    float player[3];
+    float dest[3];
+    float walls[3];
+};
+
+void mapColor(const float *c) { glColor3f(c[0], c[1], c[2]); }
+
+void mapQuad(float x0, float y0, float x1, float y1) {
+    glBegin(GL_QUADS);
+    glVertex2f(x0, y0);
+    glVertex2f(x1, y0);
+    glVertex2f(x1, y1);
+    glVertex2f(x0, y1);
+    glEnd();
+}
+
+// Pixel coordinates inside vp, no depth test; endMapView() undoes it all
+void beginMapView(const Viewport &vp) {
+    glViewport(vp.x, vp.y, vp.width, vp.height);
+    glPushAttrib(GL_ENABLE_BIT);
+    glDisable(GL_DEPTH_TEST);
     glMatrixMode(GL_PROJECTION);
     glPushMatrix();
     glLoadIdentity();
-    glOrtho(0, 800, 0, 600, -1, 1);  
+    gluOrtho2D(0, vp.width, 0, vp.height);
     glMatrixMode(GL_MODELVIEW);
     glPushMatrix();
     glLoadIdentity();
+}
 
-    glDisable(GL_DEPTH_TEST);
+void endMapView() {
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+    glPopAttrib();
+}
 
-    glColor3f(0.1f, 0.1f, 0.1f);  
-    glBegin(GL_QUADS);
-    glVertex2f(10, 10);
-    glVertex2f(160, 10);
-    glVertex2f(160, 160);
-    glVertex2f(10, 160);
-    glEnd();
+// Floor, the two highlighted cells, then every wall of the shared mesh in
+// one draw call, scaled from cell units to pixels
+void drawMapCells(const FrameSnapshot &s, float startX, float startY, float cellSize, const MapStyle &style) {
+    mapColor(style.floor);
+    mapQuad(startX, startY, startX + s.width * cellSize, startY + s.height * cellSize);
 
-    float cellSize = 140.0f / MAZE_WIDTH;
+    mapColor(style.dest);
+    float x = startX + s.destX * cellSize, y = startY + s.destZ * cellSize;
+    mapQuad(x, y, x + cellSize, y + cellSize);
 
-    for (int x = 0; x < MAZE_WIDTH; x++) {
-        for (int z = 0; z < MAZE_HEIGHT; z++) {
-            float mapX = 10 + x * cellSize;
-            float mapZ = 10 + z * cellSize;
+    mapColor(style.player);
+    x = startX + s.playerCellX * cellSize;
+    y = startY + s.playerCellZ * cellSize;
+    mapQuad(x, y, x + cellSize, y + cellSize);
 
-            // Draw cell
-            if (x == floor(playerX) && z == floor(playerZ)) {
-                // Current cell
-                glColor3f(0.2f, 0.2f, 0.5f);
-            } else if (x == destX && z == destZ) {
-                // Destination cell
-                glColor3f(0.0f, 0.5f, 0.0f);
-            } else {
-                // Regular cell
-                glColor3f(0.1f, 0.1f, 0.1f);
-            }
+    if (!s.mesh->wallCount) return;
+    mapColor(style.walls);
+    glLineWidth(2.0f);
+    glPushMatrix();
+    glTranslatef(startX, startY, 0.0f);
+    glScalef(cellSize, cellSize, 1.0f);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 0, s.mesh->wallLines);
+    glDrawArrays(GL_LINES, 0, (GLsizei)(s.mesh->wallCount * 2));
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glPopMatrix();
+    glLineWidth(1.0f);
+}
 
-            glBegin(GL_QUADS);
-            glVertex2f(mapX, mapZ);
-            glVertex2f(mapX + cellSize, mapZ);
-            glVertex2f(mapX + cellSize, mapZ + cellSize);
-            glVertex2f(mapX, mapZ + cellSize);
-            glEnd();
-
-            // Draw walls
-            glColor3f(0.7f, 0.7f, 0.7f);
-            glLineWidth(2.0f);
-
-            // North wall
-            if (maze[x][z].walls[0]) {
-                glBegin(GL_LINES);
-                glVertex2f(mapX, mapZ);
-                glVertex2f(mapX + cellSize, mapZ);
-                glEnd();
-            }
+// Other racers as orange dots
+void drawMapOthers(const FrameSnapshot &s, float startX, float startY, float cellSize, float pointSize) {
+    if (s.others->empty()) return;
+    glColor3f(1.0f, 0.5f, 0.0f);
+    glPointSize(pointSize);
+    glBegin(GL_POINTS);
+    for (size_t i = 0; i < s.others->size(); i += 3) {
+        glVertex2f(startX + (*s.others)[i] * cellSize, startY + (*s.others)[i + 1] * cellSize);
+    }
+    glEnd();
+    glPointSize(1.0f);
+}
 
-            // East wall
-            if (maze[x][z].walls[1]) {
-                glBegin(GL_LINES);
-                glVertex2f(mapX + cellSize, mapZ);
-                glVertex2f(mapX + cellSize, mapZ + cellSize);
-                glEnd();
-            }
+// 150 pixel map in the lower-left corner of vp
+void drawMiniMap(const FrameSnapshot &s, const Viewport &vp) {
+    PROFILE_SCOPE("drawMiniMap");
+    static const MapStyle style = {
+        {0.1f, 0.1f, 0.1f}, {0.1f, 0.1f, 0.1f}, {0.2f, 0.2f, 0.5f}, {0.0f, 0.5f, 0.0f}, {0.7f, 0.7f, 0.7f}};
+    Viewport map = {vp.x + 10, vp.y + 10, 150, 150};
+    beginMapView(map);
 
-            // South wall
-            if (maze[x][z].walls[2]) {
-                glBegin(GL_LINES);
-                glVertex2f(mapX, mapZ + cellSize);
-                glVertex2f(mapX + cellSize, mapZ + cellSize);
-                glEnd();
-            }
+    mapColor(style.background);
+    mapQuad(0, 0, map.width, map.height);
 
-            // West wall
-            if (maze[x][z].walls[3]) {
-                glBegin(GL_LINES);
-                glVertex2f(mapX, mapZ);
-                glVertex2f(mapX, mapZ + cellSize);
-                glEnd();
-            }
-        }
-    }
+    float cellSize = 140.0f / max(s.width, s.height);
+    drawMapCells(s, 5, 5, cellSize, style);
+    drawMapOthers(s, 5, 5, cellSize, 5.0f);
 
     // Draw player position on mini-map
-    float playerMapX = 10 + playerX * cellSize;
-    float playerMapZ = 10 + playerZ * cellSize;
+    float playerMapX = 5 + s.playerX * cellSize;
+    float playerMapZ = 5 + s.playerZ * cellSize;
 
     glColor3f(1.0f, 0.0f, 0.0f);
     glPointSize(5.0f);
     glBegin(GL_POINTS);
     glVertex2f(playerMapX, playerMapZ);
     glEnd();
+    glPointSize(1.0f);
 
     // Draw player direction
     glColor3f(1.0f, 1.0f, 0.0f);
     glBegin(GL_LINES);
     glVertex2f(playerMapX, playerMapZ);
-    glVertex2f(playerMapX + cos(playerAngle) * cellSize * 0.5f, playerMapZ + sin(playerAngle) * cellSize * 0.5f);
+    glVertex2f(playerMapX + cos(s.playerAngle) * cellSize * 0.5f, playerMapZ + sin(s.playerAngle) * cellSize * 0.5f);
     glEnd();
 
-    // Reset settings
-    glLineWidth(1.0f);
-    glPointSize(1.0f);
-    glEnable(GL_DEPTH_TEST);
-
-    // Restore matrices
-    glMatrixMode(GL_PROJECTION);
-    glPopMatrix();
-    glMatrixMode(GL_MODELVIEW);
-    glPopMatrix();
+    endMapView();
 }
 
-void drawBirdEyeView() {
-    int windowWidth = glutGet(GLUT_WINDOW_WIDTH);
-    int windowHeight = glutGet(GLUT_WINDOW_HEIGHT);
+void drawBirdEyeView(const FrameSnapshot &s, const Viewport &vp, bool hints) {
+    PROFILE_SCOPE("drawBirdEyeView");
+    static const MapStyle style = {
+        {0.2f, 0.2f, 0.2f}, {0.8f, 0.8f, 0.8f}, {0.0f, 0.0f, 0.8f}, {0.0f, 0.8f, 0.0f}, {0.0f, 0.0f, 0.0f}};
+    beginMapView(vp);
 
-    int minDimension = min(windowWidth, windowHeight) - 40;  
-    float cellSize = minDimension / (float)max(MAZE_WIDTH, MAZE_HEIGHT);
+    int minDimension = min(vp.width, vp.height) - 40;
+    float cellSize = minDimension / (float)max(s.width, s.height);
 
-    float startX = (windowWidth - MAZE_WIDTH * cellSize) / 2;
-    float startY = (windowHeight - MAZE_HEIGHT * cellSize) / 2;
+    float startX = (vp.width - s.width * cellSize) / 2;
+    float startY = (vp.height - s.height * cellSize) / 2;
 
-    glColor3f(0.2f, 0.2f, 0.2f);
-    glBegin(GL_QUADS);
-    glVertex2f(0, 0);
-    glVertex2f(windowWidth, 0);
-    glVertex2f(windowWidth, windowHeight);
-    glVertex2f(0, windowHeight);
-    glEnd();
+    mapColor(style.background);
+    mapQuad(0, 0, vp.width, vp.height);
+    drawMapCells(s, startX, startY, cellSize, style);
+    drawMapOthers(s, startX, startY, cellSize, max(3.0f, cellSize * 0.4f));
 
-    for (int x = 0; x < MAZE_WIDTH; x++) {
-        for (int z = 0; z < MAZE_HEIGHT; z++) {
-            float cellX = startX + x * cellSize;
-            float cellY = startY + z * cellSize;
-
-            if (x == floor(playerX) && z == floor(playerZ)) {
-                glColor3f(0.0f, 0.0f, 0.8f);
-            } else if (x == destX && z == destZ) {
-                glColor3f(0.0f, 0.8f, 0.0f);
-            } else {
-                glColor3f(0.8f, 0.8f, 0.8f);
-            }
-
-            glBegin(GL_QUADS);
-            glVertex2f(cellX, cellY);
-            glVertex2f(cellX + cellSize, cellY);
-            glVertex2f(cellX + cellSize, cellY + cellSize);
-            glVertex2f(cellX, cellY + cellSize);
-            glEnd();
-
-            glColor3f(0.0f, 0.0f, 0.0f);
-            glLineWidth(2.0f);
-
-            // North wall
-            if (maze[x][z].walls[0]) {
-                glBegin(GL_LINES);
-                glVertex2f(cellX, cellY);
-                glVertex2f(cellX + cellSize, cellY);
-                glEnd();
-            }
-
-            // East wall
-            if (maze[x][z].walls[1]) {
-                glBegin(GL_LINES);
-                glVertex2f(cellX + cellSize, cellY);
-                glVertex2f(cellX + cellSize, cellY + cellSize);
-                glEnd();
-            }
-
-            // South wall
-            if (maze[x][z].walls[2]) {
-                glBegin(GL_LINES);
-                glVertex2f(cellX, cellY + cellSize);
-                glVertex2f(cellX + cellSize, cellY + cellSize);
-                glEnd();
-            }
-
-            // West wall
-            if (maze[x][z].walls[3]) {
-                glBegin(GL_LINES);
-                glVertex2f(cellX, cellY);
-                glVertex2f(cellX, cellY + cellSize);
-                glEnd();
-            }
-        }
-    }
-
-    float playerCellX = startX + playerX * cellSize;
-    float playerCellY = startY + playerZ * cellSize;
+    float playerCellX = startX + s.playerX * cellSize;
+    float playerCellY = startY + s.playerZ * cellSize;
 
     glColor3f(1.0f, 0.0f, 0.0f);
 
@@ -1002,22 +2381,27 @@ void drawBirdEyeView() {
     glLineWidth(3.0f);
     glBegin(GL_LINES);
     glVertex2f(playerCellX, playerCellY);
-    glVertex2f(playerCellX + radius * 1.5f * cos(playerAngle), playerCellY + radius * 1.5f * sin(playerAngle));
+    glVertex2f(playerCellX + radius * 1.5f * cos(s.playerAngle), playerCellY + radius * 1.5f * sin(s.playerAngle));
     glEnd();
     glLineWidth(1.0f);
 
-    glColor3f(1.0f, 1.0f, 1.0f);
-    glRasterPos2f(10, 20);
-    const char* text = "Press 'f' to return to first-person view";
-    for (const char* c = text; *c != '\0'; c++) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, *c);
+    if (hints) {
+        glColor3f(1.0f, 1.0f, 1.0f);
+        TextCache::draw(textCache.layout(GLUT_BITMAP_HELVETICA_12, "Press 'f' to return to first-person view"), 10,
+                        20);
+
+        char line[128];
+        snprintf(line, sizeof(line), "dead ends %ld  junctions %ld  branching %.2f  longest path %d  (%.2f ms)",
+                 mazeStats.deadEnds, mazeStats.junctions, mazeStats.branching, mazeStats.longestPath,
+                 mazeStats.analysisMs);
+        TextCache::draw(textCache.slot(0, GLUT_BITMAP_HELVETICA_12, line), 10, 40);
     }
+
+    endMapView();
 }
 
 void drawSuccessScreen() {
-    int windowWidth = glutGet(GLUT_WINDOW_WIDTH);
-    int windowHeight = glutGet(GLUT_WINDOW_HEIGHT);
-
+    PROFILE_SCOPE("drawSuccessScreen");
     glMatrixMode(GL_PROJECTION);
     glPushMatrix();
     glLoadIdentity();
@@ -1036,60 +2420,25 @@ void drawSuccessScreen() {
     glEnd();
 
     glColor3f(1.0f, 1.0f, 0.0f);  // Yellow text
-    const char* congratsText = "Congratulations!";
-    const char* successText = "You have successfully completed the maze!";
-    const char* restartText = "Press 'R' to restart";
-    const char* exitText = "Press 'Q' to exit";
-
-    // Calculate text positions
-    int textWidth = 0;
-    for (const char* c = congratsText; *c != '\0'; c++) {
-        textWidth += glutBitmapWidth(GLUT_BITMAP_TIMES_ROMAN_24, *c);
-    }
-    float congratsX = (windowWidth - textWidth) / 2.0f;
-    float congratsY = windowHeight * 0.6f;
-
-    textWidth = 0;
-    for (const char* c = successText; *c != '\0'; c++) {
-        textWidth += glutBitmapWidth(GLUT_BITMAP_HELVETICA_18, *c);
-    }
-    float successX = (windowWidth - textWidth) / 2.0f;
-    float successY = windowHeight * 0.5f;
-
-    textWidth = 0;
-    for (const char* c = restartText; *c != '\0'; c++) {
-        textWidth += glutBitmapWidth(GLUT_BITMAP_HELVETICA_12, *c);
-    }
-    float restartX = (windowWidth - textWidth) / 2.0f;
-    float restartY = windowHeight * 0.3f;
-
-    textWidth = 0;
-    for (const char* c = exitText; *c != '\0'; c++) {
-        textWidth += glutBitmapWidth(GLUT_BITMAP_HELVETICA_12, *c);
-    }
-    float exitX = (windowWidth - textWidth) / 2.0f;
-    float exitY = windowHeight * 0.25f;
-
-    // Draw the text
-    glRasterPos2f(congratsX, congratsY);
-    for (const char* c = congratsText; *c != '\0'; c++) {
-        glutBitmapCharacter(GLUT_BITMAP_TIMES_ROMAN_24, *c);
-    }
-
-    glRasterPos2f(successX, successY);
-    for (const char* c = successText; *c != '\0'; c++) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, *c);
-    }
-
-    glRasterPos2f(restartX, restartY);
-    for (const char* c = restartText; *c != '\0'; c++) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, *c);
-    }
-
-    glRasterPos2f(exitX, exitY);
-    for (const char* c = exitText; *c != '\0'; c++) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, *c);
-    }
+    // Layouts are measured and compiled on first use, later frames only
+    // position them
+    bool lost = raceWinner >= 0 && raceWinner != netId;
+    char result[64];
+    snprintf(result, sizeof(result), "Player %d reached the exit first", raceWinner);
+    const TextLayout &congrats = textCache.layout(GLUT_BITMAP_TIMES_ROMAN_24, lost ? "Race over" : "Congratulations!");
+    const TextLayout &success =
+        lost ? textCache.slot(1, GLUT_BITMAP_HELVETICA_18, result)
+             : textCache.layout(GLUT_BITMAP_HELVETICA_18, "You have successfully completed the maze!");
+    const char *hint = netClient        ? "Waiting for the host to restart"
+                       : restartPending ? "Generating the next maze..."
+                                        : "Press 'R' to restart";
+    const TextLayout &restart = textCache.layout(GLUT_BITMAP_HELVETICA_12, hint);
+    const TextLayout &exitHint = textCache.layout(GLUT_BITMAP_HELVETICA_12, "Press 'Q' to exit");
+
+    TextCache::draw(congrats, (windowWidth - congrats.width) / 2.0f, windowHeight * 0.6f);
+    TextCache::draw(success, (windowWidth - success.width) / 2.0f, windowHeight * 0.5f);
+    TextCache::draw(restart, (windowWidth - restart.width) / 2.0f, windowHeight * 0.3f);
+    TextCache::draw(exitHint, (windowWidth - exitHint.width) / 2.0f, windowHeight * 0.25f);
 
     // Draw a decorative border
     glColor3f(1.0f, 0.8f, 0.0f);  // Gold color
@@ -0,0 +1,90 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+// Bump allocator for data that lives exactly as long as one maze. alloc()
+// hands out aligned slices of one block and reset() takes them all back at
+// once. No constructors or destructors run, so it holds plain arrays.
+//
+// A maze that needs more than the block spills into blocks of its own. The
+// next reset() frees those and replaces the block with one a quarter
+// larger than the high-water mark. After the first maze of a size,
+// regenerating it makes no allocator calls, and the block's pages stay
+// mapped from one maze to the next.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+class Arena {
+public:
+    Arena() : base(NULL), size(0), used(0), spilled(0), allocations(0) {}
+    ~Arena() {
+        release();
+        delete[] base;
+    }
+
+    // Uninitialized room for n T, 64-byte aligned so rows start on a cache line
+    template <class T>
+    T *alloc(size_t n) {
+        return (T *)bytes(n * sizeof(T));
+    }
+
+    void reset() {
+        if (spilled) {
+            size_t want = (used + spilled) / 4 * 5 + ALIGN;
+            release();
+            delete[] base;
+            base = new char[want];
+            size = want;
+            allocations++;
+        }
+        used = spilled = 0;
+    }
+
+    // Trades blocks and counters, e.g. between a front and a back buffer
+    void swap(Arena &other) {
+        std::swap(base, other.base);
+        std::swap(size, other.size);
+        std::swap(used, other.used);
+        std::swap(spilled, other.spilled);
+        std::swap(allocations, other.allocations);
+        spills.swap(other.spills);
+    }
+
+    size_t capacity() const { return size; }
+    size_t bytesUsed() const { return used + spilled; }
+    long blockAllocations() const { return allocations; }  // since construction
+
+private:
+    static const size_t ALIGN = 64;
+
+    void *bytes(size_t n) {
+        size_t offset = (ALIGN - ((uintptr_t)(base + used) & (ALIGN - 1))) & (ALIGN - 1);
+        if (base && used + offset + n <= size) {
+            char *p = base + used + offset;
+            used += offset + n;
+            return p;
+        }
+        char *block = new char[n + ALIGN];
+        spills.push_back(block);
+        spilled += n + ALIGN;
+        allocations++;
+        return block + ((ALIGN - ((uintptr_t)block & (ALIGN - 1))) & (ALIGN - 1));
+    }
+
+    void release() {
+        for (size_t i = 0; i < spills.size(); i++) delete[] spills[i];
+        spills.clear();
+    }
+
+    char *base;
+    size_t size;
+    size_t used;
+    size_t spilled;  // bytes in spill blocks
+    long allocations;
+    std::vector<char *> spills;
+};
+
+#endif
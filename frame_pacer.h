@@ -0,0 +1,95 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+// Portable frame pacer, replaces Sleep() based throttling in idle callbacks,
+// plus swap-interval (vsync) control.
+// wait() blocks until the next frame deadline: it sleeps for most of the
+// interval and spins for the last millisecond, which keeps pacing accurate
+// on systems with a coarse sleep granularity.
+
+#include <chrono>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#pragma comment(lib, "winmm.lib")
+#elif !defined(__APPLE__)
+// Declared by hand to keep the X11 macros out of the programs
+extern "C" void (*glXGetProcAddressARB(const unsigned char *name))(void);
+#endif
+
+class FramePacer {
+public:
+    typedef std::chrono::steady_clock clock_type;
+
+    explicit FramePacer(double fps = 60.0) {
+#ifdef _WIN32
+        // 1 ms scheduler tick instead of the default 15.6 ms
+        timeBeginPeriod(1);
+#endif
+        setTargetFps(fps);
+        next = clock_type::now();
+    }
+
+    ~FramePacer() {
+#ifdef _WIN32
+        timeEndPeriod(1);
+#endif
+    }
+
+    // 0 disables the cap and wait() returns immediately
+    void setTargetFps(double fps) {
+        targetFps = fps;
+        if (fps > 0.0) {
+            interval = std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(1.0 / fps));
+        }
+    }
+
+    double getTargetFps() const { return targetFps; }
+
+    void wait() {
+        if (targetFps <= 0.0) return;
+
+        next += interval;
+        clock_type::time_point now = clock_type::now();
+        if (now > next + interval) {
+            // Fell more than a frame behind: restart the schedule instead of bursting
+            next = now;
+            return;
+        }
+
+        clock_type::time_point coarse = next - std::chrono::milliseconds(1);
+        if (now < coarse) std::this_thread::sleep_until(coarse);
+        while (clock_type::now() < next) {
+        }
+    }
+
+private:
+    double targetFps;
+    clock_type::duration interval;
+    clock_type::time_point next;
+};
+
+// Turns vsync on (1) or off (0) for the current context. Returns false when
+// the driver exposes no swap control, in which case a pacer cap is the only
+// throttle.
+inline bool setSwapInterval(int interval) {
+#if defined(_WIN32)
+    typedef BOOL(WINAPI * SwapIntervalEXT)(int);
+    SwapIntervalEXT swapInterval = (SwapIntervalEXT)wglGetProcAddress("wglSwapIntervalEXT");
+    return swapInterval && swapInterval(interval);
+#elif !defined(__APPLE__)
+    typedef int (*SwapIntervalMESA)(unsigned int);
+    typedef int (*SwapIntervalSGI)(int);
+    SwapIntervalMESA mesa = (SwapIntervalMESA)glXGetProcAddressARB((const unsigned char *)"glXSwapIntervalMESA");
+    if (mesa && mesa((unsigned int)interval) == 0) return true;
+    // SGI swap control cannot turn vsync off
+    SwapIntervalSGI sgi = (SwapIntervalSGI)glXGetProcAddressARB((const unsigned char *)"glXSwapIntervalSGI");
+    return interval > 0 && sgi && sgi(interval) == 0;
+#else
+    (void)interval;
+    return false;
+#endif
+}
+
+#endif
@@ -0,0 +1,116 @@
+// Minimal GLUT replacement for the headless harness: no window system, the
+// window is the harness' offscreen surface and callbacks are only recorded.
+
+#include <GL/gl.h>
+
+#include <chrono>
+#include <cmath>
+
+#include <GL/glut.h>
+
+#include "harness.h"
+
+void (*headlessIdleFunc)(void) = 0;
+
+static std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+extern "C" {
+
+// Font handles only need distinct addresses
+void *glutStrokeRoman;
+void *glutStrokeMonoRoman;
+void *glutBitmap9By15;
+void *glutBitmap8By13;
+void *glutBitmapTimesRoman10;
+void *glutBitmapTimesRoman24;
+void *glutBitmapHelvetica10;
+void *glutBitmapHelvetica12;
+void *glutBitmapHelvetica18;
+
+void glutInit(int *, char **) {}
+void glutInitDisplayMode(unsigned int) {}
+void glutInitWindowSize(int, int) {}
+void glutInitWindowPosition(int, int) {}
+int glutCreateWindow(const char *) { return 1; }
+void glutMainLoop(void) {}
+
+void glutDisplayFunc(void (*)(void)) {}
+void glutReshapeFunc(void (*)(int, int)) {}
+void glutKeyboardFunc(void (*)(unsigned char, int, int)) {}
+void glutMouseFunc(void (*)(int, int, int, int)) {}
+void glutMotionFunc(void (*)(int, int)) {}
+void glutPassiveMotionFunc(void (*)(int, int)) {}
+void glutIdleFunc(void (*func)(void)) { headlessIdleFunc = func; }
+void glutTimerFunc(unsigned int, void (*)(int), int) {}
+
+int glutCreateMenu(void (*)(int)) { return 1; }
+void glutAddMenuEntry(const char *, int) {}
+void glutAddSubMenu(const char *, int) {}
+void glutAttachMenu(int) {}
+
+void glutPostRedisplay(void) { headlessRedisplay = true; }
+void glutWarpPointer(int, int) {}
+void glutSetCursor(int) {}
+void glutSwapBuffers(void) { glFinish(); }
+
+int glutGet(GLenum type) {
+    switch (type) {
+        case GLUT_WINDOW_WIDTH:
+            return headlessWidth;
+        case GLUT_WINDOW_HEIGHT:
+            return headlessHeight;
+        case GLUT_ELAPSED_TIME:
+            return (int)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+                                                                              startTime)
+                .count();
+    }
+    return 0;
+}
+
+// Text is not rasterized headless; widths approximate the GLUT fonts so
+// layout code still runs
+void glutBitmapCharacter(void *, int) {}
+int glutBitmapWidth(void *font, int) {
+    if (font == GLUT_BITMAP_TIMES_ROMAN_24) return 12;
+    if (font == GLUT_BITMAP_HELVETICA_18) return 10;
+    return 7;
+}
+
+void glutSolidSphere(GLdouble radius, GLint slices, GLint stacks) {
+    const double PI = 3.14159265358979323846;
+    glBegin(GL_TRIANGLES);
+    for (int i = 0; i < stacks; i++) {
+        double p0 = PI * i / stacks - PI / 2, p1 = PI * (i + 1) / stacks - PI / 2;
+        for (int j = 0; j < slices; j++) {
+            double a0 = 2 * PI * j / slices, a1 = 2 * PI * (j + 1) / slices;
+            double v[4][3] = {
+                {cos(p0) * cos(a0), sin(p0), cos(p0) * sin(a0)},
+                {cos(p0) * cos(a1), sin(p0), cos(p0) * sin(a1)},
+                {cos(p1) * cos(a1), sin(p1), cos(p1) * sin(a1)},
+                {cos(p1) * cos(a0), sin(p1), cos(p1) * sin(a0)},
+            };
+            const int tri[6] = {0, 2, 1, 0, 3, 2};
+            for (int k = 0; k < 6; k++) {
+                glNormal3d(v[tri[k]][0], v[tri[k]][1], v[tri[k]][2]);
+                glVertex3d(radius * v[tri[k]][0], radius * v[tri[k]][1], radius * v[tri[k]][2]);
+            }
+        }
+    }
+    glEnd();
+}
+
+void glutWireCube(GLdouble size) {
+    double s = size / 2;
+    const int edges[12][2] = {{0, 1}, {1, 3}, {3, 2}, {2, 0}, {4, 5}, {5, 7},
+                              {7, 6}, {6, 4}, {0, 4}, {1, 5}, {2, 6}, {3, 7}};
+    glBegin(GL_LINES);
+    for (int e = 0; e < 12; e++) {
+        for (int k = 0; k < 2; k++) {
+            int c = edges[e][k];
+            glVertex3d(c & 1 ? s : -s, c & 2 ? s : -s, c & 4 ? s : -s);
+        }
+    }
+    glEnd();
+}
+
+}  // extern "C"
@@ -0,0 +1,244 @@
+#include "harness.h"
+
+#ifdef HARNESS_SOFTGL
+#include "../softgl/softgl.h"
+#else
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+#include <GL/gl.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+int headlessWidth = 500;
+int headlessHeight = 500;
+bool headlessRedisplay = false;
+
+namespace harness {
+
+#ifndef HARNESS_SOFTGL
+static EGLDisplay display = EGL_NO_DISPLAY;
+static EGLSurface surface = EGL_NO_SURFACE;
+static EGLContext context = EGL_NO_CONTEXT;
+#endif
+
+Options parseOptions(int argc, char **argv) {
+    Options opt;
+    opt.width = 500;
+    opt.height = 500;
+    opt.frames = 30;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            sscanf(argv[++i], "%dx%d", &opt.width, &opt.height);
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            opt.frames = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            opt.out = argv[++i];
+        }
+    }
+    return opt;
+}
+
+#ifdef HARNESS_SOFTGL
+bool createContext(int width, int height) {
+    // 0 threads: one worker per hardware thread
+    if (!softglCreateContext(width, height, 0)) {
+        std::cerr << "harness: cannot create software context" << std::endl;
+        return false;
+    }
+    headlessWidth = width;
+    headlessHeight = height;
+    glViewport(0, 0, width, height);
+    return true;
+}
+
+void destroyContext() { softglDestroyContext(); }
+#else
+bool createContext(int width, int height) {
+    // Surfaceless Mesa needs neither X nor a DRM device
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay) {
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+    if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        std::cerr << "harness: no EGL display" << std::endl;
+        return false;
+    }
+
+    const EGLint configAttribs[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RED_SIZE,   8,
+                                    EGL_GREEN_SIZE,   8,               EGL_BLUE_SIZE,  8,
+                                    EGL_DEPTH_SIZE,   24,              EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                    EGL_NONE};
+    EGLConfig config;
+    EGLint count = 0;
+    if (!eglChooseConfig(display, configAttribs, &config, 1, &count) || count == 0) {
+        std::cerr << "harness: no pbuffer config" << std::endl;
+        return false;
+    }
+
+    const EGLint surfaceAttribs[] = {EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE};
+    surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+
+    // The homework programs use the fixed-function pipeline: ask for a default
+    // (compatibility) desktop GL context
+    eglBindAPI(EGL_OPENGL_API);
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, NULL);
+    if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT ||
+        !eglMakeCurrent(display, surface, surface, context)) {
+        std::cerr << "harness: cannot create offscreen context" << std::endl;
+        return false;
+    }
+
+    headlessWidth = width;
+    headlessHeight = height;
+    glViewport(0, 0, width, height);
+    return true;
+}
+
+void destroyContext() {
+    if (display == EGL_NO_DISPLAY) return;
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+    if (surface != EGL_NO_SURFACE) eglDestroySurface(display, surface);
+    eglTerminate(display);
+    display = EGL_NO_DISPLAY;
+}
+#endif
+
+const char *rendererName() {
+    const GLubyte *name = glGetString(GL_RENDERER);
+    return name ? (const char *)name : "unknown";
+}
+
+Step runStep(const std::string &label, DisplayFunc displayFunc, int frames) {
+    typedef std::chrono::steady_clock clock_type;
+
+    Step step;
+    step.label = label;
+
+    // One untimed frame so shader compilation and caches do not skew the first sample
+    displayFunc();
+    glFinish();
+
+    for (int i = 0; i < frames; i++) {
+        clock_type::time_point t0 = clock_type::now();
+        displayFunc();
+        // glutSwapBuffers() is a glFinish() here, so this includes rasterization
+        clock_type::time_point t1 = clock_type::now();
+        step.frameMs.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+    }
+    step.hash = hashFramebuffer();
+    headlessRedisplay = false;
+    return step;
+}
+
+uint64_t hashFramebuffer() {
+    std::vector<unsigned char> pixels((size_t)headlessWidth * headlessHeight * 4);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, headlessWidth, headlessHeight, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < pixels.size(); i++) {
+        hash ^= pixels[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+long strayViewportPixels() {
+    int half = headlessWidth / 2;
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glViewport(0, 0, half, headlessHeight);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+
+    // Inside the guard band, well outside the viewport
+    glColor3f(1.0f, 1.0f, 1.0f);
+    glBegin(GL_TRIANGLES);
+    glVertex2f(-3.0f, -3.0f);
+    glVertex2f(3.0f, -3.0f);
+    glVertex2f(0.0f, 3.0f);
+    glEnd();
+    glBegin(GL_LINES);
+    glVertex2f(-2.0f, 0.5f);
+    glVertex2f(2.0f, -0.5f);
+    glEnd();
+    glFinish();
+
+    std::vector<unsigned char> pixels((size_t)headlessWidth * headlessHeight * 4);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, headlessWidth, headlessHeight, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+    long stray = 0;
+    for (int y = 0; y < headlessHeight; y++) {
+        for (int x = half; x < headlessWidth; x++) {
+            if (pixels[((size_t)y * headlessWidth + x) * 4]) stray++;
+        }
+    }
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glViewport(0, 0, headlessWidth, headlessHeight);
+    return stray;
+}
+
+static double percentile(std::vector<double> sorted, double p) {
+    std::sort(sorted.begin(), sorted.end());
+    size_t i = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[i];
+}
+
+static std::string escape(const std::string &s) {
+    std::string out;
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s[i] == '"' || s[i] == '\\') out += '\\';
+        out += s[i];
+    }
+    return out;
+}
+
+bool writeJson(const Options &opt, const char *program, const std::vector<Step> &steps) {
+    std::ostringstream json;
+    json << "{\n  \"program\": \"" << program << "\",\n"
+         << "  \"renderer\": \"" << escape(rendererName()) << "\",\n"
+         << "  \"width\": " << opt.width << ",\n  \"height\": " << opt.height << ",\n"
+         << "  \"steps\": [\n";
+
+    for (size_t i = 0; i < steps.size(); i++) {
+        const Step &s = steps[i];
+        double total = 0.0;
+        for (size_t f = 0; f < s.frameMs.size(); f++) total += s.frameMs[f];
+
+        char hash[17];
+        snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)s.hash);
+        json << "    {\"label\": \"" << escape(s.label) << "\", \"frames\": " << s.frameMs.size()
+             << ", \"mean_ms\": " << total / s.frameMs.size()
+             << ", \"min_ms\": " << percentile(s.frameMs, 0.0) << ", \"p50_ms\": " << percentile(s.frameMs, 0.5)
+             << ", \"p95_ms\": " << percentile(s.frameMs, 0.95) << ", \"max_ms\": " << percentile(s.frameMs, 1.0)
+             << ", \"hash\": \"" << hash << "\"}" << (i + 1 < steps.size() ? "," : "") << "\n";
+    }
+    json << "  ]\n}\n";
+
+    if (opt.out.empty()) {
+        std::cout << json.str();
+        return true;
+    }
+    std::ofstream file(opt.out.c_str());
+    file << json.str();
+    return (bool)file;
+}
+
+}  // namespace harness
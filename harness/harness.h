@@ -0,0 +1,59 @@
+#ifndef HARNESS_H
+#define HARNESS_H
+
+// Headless regression / throughput harness.
+//
+// Each hwNN_harness.cpp includes one homework source with its main() renamed,
+// renders it into an offscreen EGL pbuffer (Mesa llvmpipe works without a GPU)
+// and drives a scripted list of state changes. GLUT itself is replaced by
+// glut_headless.cpp, so no window system is needed.
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace harness {
+
+struct Options {
+    int width;
+    int height;
+    int frames;       // frames rendered per scripted step
+    std::string out;  // JSON output path, stdout if empty
+};
+
+struct Step {
+    std::string label;
+    std::vector<double> frameMs;
+    uint64_t hash;  // FNV-1a of the last frame's RGBA pixels
+};
+
+// Parses --size WxH, --frames N and --out FILE
+Options parseOptions(int argc, char **argv);
+
+// Creates the offscreen context, false if no EGL display is available
+bool createContext(int width, int height);
+void destroyContext();
+const char *rendererName();
+
+// Renders `frames` frames through display and records their timings
+typedef void (*DisplayFunc)();
+Step runStep(const std::string &label, DisplayFunc display, int frames);
+
+uint64_t hashFramebuffer();
+
+// Draws a triangle and a line reaching far past a viewport on the left half
+// of the framebuffer and returns how many pixels were lit outside it, which
+// GL never does. Leaves the framebuffer cleared and the viewport full.
+long strayViewportPixels();
+bool writeJson(const Options &opt, const char *program, const std::vector<Step> &steps);
+
+}  // namespace harness
+
+// Window size and redisplay state seen by the GLUT replacement
+extern int headlessWidth;
+extern int headlessHeight;
+extern bool headlessRedisplay;
+extern void (*headlessIdleFunc)(void);
+
+#endif
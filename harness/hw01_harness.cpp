@@ -0,0 +1,30 @@
+// Headless driver for Hw_01: regular polygons with increasing n, then the
+// adaptive circle (n = 0)
+#define main hw01_main
+#include "../Hw_01.cpp"
+#undef main
+
+#include <sstream>
+
+#include "harness.h"
+
+int main(int argc, char **argv) {
+    harness::Options opt = harness::parseOptions(argc, argv);
+    if (!harness::createContext(opt.width, opt.height)) return 1;
+
+    init();
+    reshape(opt.width, opt.height);
+
+    const int sides[] = {3, 6, 64, 1000, 100000, 0};
+    vector<harness::Step> steps;
+    for (int i = 0; i < 6; i++) {
+        n = sides[i];
+        ostringstream label;
+        label << "n=" << n;
+        steps.push_back(harness::runStep(label.str(), display, opt.frames));
+    }
+
+    bool ok = harness::writeJson(opt, "Hw_01", steps);
+    harness::destroyContext();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,47 @@
+// Headless driver for Hw_02: ellipse rotation angles and translations, then
+// the particle mode
+#define main hw02_main
+#include "../Hw_02.cpp"
+#undef main
+
+#include <sstream>
+
+#include "harness.h"
+
+int main(int argc, char **argv) {
+    harness::Options opt = harness::parseOptions(argc, argv);
+    if (!harness::createContext(opt.width, opt.height)) return 1;
+
+    init();
+    reshape(opt.width, opt.height);
+
+    const float angles[] = {0.0f, 30.0f, 90.0f, 180.0f, 270.0f};
+    const float offsets[][2] = {{0.0f, 0.0f}, {0.3f, 0.0f}, {0.0f, -0.3f}};
+    vector<harness::Step> steps;
+    for (int o = 0; o < 3; o++) {
+        for (int a = 0; a < 5; a++) {
+            theta = angles[a];
+            xx = offsets[o][0];
+            yy = offsets[o][1];
+            ostringstream label;
+            label << "theta=" << theta << " xx=" << xx << " yy=" << yy;
+            steps.push_back(harness::runStep(label.str(), display, opt.frames));
+        }
+    }
+
+    // Particle mode; idle() is not run, so the field stays still
+    theta = 0.0f;
+    xx = yy = 0.0f;
+    const int counts[] = {1000, 10000};
+    for (int c = 0; c < 2; c++) {
+        initParticles(counts[c]);
+        ostringstream label;
+        label << "particles=" << counts[c];
+        steps.push_back(harness::runStep(label.str(), display, opt.frames));
+    }
+    initParticles(0);
+
+    bool ok = harness::writeJson(opt, "Hw_02", steps);
+    harness::destroyContext();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,55 @@
+// Headless driver for Hw_03: arm poses, gripper settings and IK targets
+#define main hw03_main
+#include "../Hw_03.cpp"
+#undef main
+
+#include "harness.h"
+
+struct ArmStep {
+    const char *label;
+    float x, y, theta, h, l;
+};
+
+int main(int argc, char **argv) {
+    harness::Options opt = harness::parseOptions(argc, argv);
+    if (!harness::createContext(opt.width, opt.height)) return 1;
+
+    init();
+    reshape(opt.width, opt.height);
+    scatterBoxes(boxes, 12, 3.0f, 2024);
+    buildFloorGrid(floorGrid, boxes, -1);
+
+    const ArmStep script[] = {
+        {"rest", 0.0f, 0.0f, 0.0f, 0.2f, 0.2f},
+        {"rotate 90", 0.0f, 0.0f, 90.0f, 0.2f, 0.2f},
+        {"rotate -45", 0.0f, 0.0f, -45.0f, 0.2f, 0.2f},
+        {"gripper down", 0.0f, 0.0f, 0.0f, 0.6f, 0.2f},
+        {"gripper open", 0.0f, 0.0f, 0.0f, 0.2f, 0.4f},
+        {"gripper closed", 0.0f, 0.0f, 0.0f, 0.2f, 0.1f},
+        {"base moved", 0.5f, -0.3f, 30.0f, 0.4f, 0.3f},
+    };
+
+    vector<harness::Step> steps;
+    for (size_t i = 0; i < sizeof(script) / sizeof(script[0]); i++) {
+        x = script[i].x;
+        y = script[i].y;
+        theta = script[i].theta;
+        h = script[i].h;
+        l = script[i].l;
+        steps.push_back(harness::runStep(script[i].label, display, opt.frames));
+    }
+
+    ArmPose rest = {0.0f, 0.0f, 0.0f, 0.2f};
+    ArmPose pose;
+    if (solveIK(0.2f, 0.2f, -0.6f, rest, pose)) {
+        x = pose.x;
+        y = pose.y;
+        theta = pose.theta;
+        h = pose.h;
+        steps.push_back(harness::runStep("ik target", display, opt.frames));
+    }
+
+    bool ok = harness::writeJson(opt, "Hw_03", steps);
+    harness::destroyContext();
+    return ok ? 0 : 1;
+}
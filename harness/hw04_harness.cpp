@@ -0,0 +1,91 @@
+// Headless driver for Hw_04: a fixed-seed maze walked through both views
+#define main hw04_main
+#include "../Hw_04.cpp"
+#undef main
+
+#include "harness.h"
+
+static void press(unsigned char key, int times) {
+    for (int i = 0; i < times; i++) keyboard(key, 0, 0);
+}
+
+int main(int argc, char **argv) {
+    harness::Options opt = harness::parseOptions(argc, argv);
+    if (!harness::createContext(opt.width, opt.height)) return 1;
+
+    // The layouts below draw several views side by side
+    long stray = harness::strayViewportPixels();
+    if (stray) {
+        cerr << "harness: " << stray << " pixels drawn outside the viewport" << endl;
+        return 1;
+    }
+
+    mazeSeed = 1;
+    init();
+    reshape(opt.width, opt.height);
+    generateMaze();
+
+    vector<harness::Step> steps;
+    steps.push_back(harness::runStep("first person start", display, opt.frames));
+
+    press('w', 10);
+    steps.push_back(harness::runStep("forward x10", display, opt.frames));
+
+    mouseFunc(GLUT_RIGHT_BUTTON, GLUT_DOWN, 0, 0);
+    press('w', 5);
+    steps.push_back(harness::runStep("turn right, forward x5", display, opt.frames));
+
+    press('d', 3);
+    steps.push_back(harness::runStep("strafe right x3", display, opt.frames));
+
+    press('b', 1);
+    steps.push_back(harness::runStep("bird eye", display, opt.frames));
+
+    press('f', 1);
+    steps.push_back(harness::runStep("first person again", display, opt.frames));
+
+    playerX = destX + 0.5f;
+    playerZ = destZ + 0.5f;
+    steps.push_back(harness::runStep("success screen", display, opt.frames));
+
+    // Same view through the raycaster, then both renderers on a larger maze
+    gameWon = false;
+    playerX = playerZ = 1.5f;
+    playerAngle = 0.0f;
+    press('c', 1);
+    steps.push_back(harness::runStep("raycast start", display, opt.frames));
+
+    mazeWidth = mazeHeight = 64;
+    destX = destZ = mazeWidth - 2;
+    generateMaze();
+    steps.push_back(harness::runStep("raycast 64x64", display, opt.frames));
+    press('c', 1);
+    steps.push_back(harness::runStep("geometry 64x64", display, opt.frames));
+    press('o', 1);
+    steps.push_back(harness::runStep("geometry 64x64 unculled", display, opt.frames));
+
+    // All three views from one snapshot
+    press('o', 1);
+    press('v', 1);
+    steps.push_back(harness::runStep("split screen 64x64", display, opt.frames));
+    press('v', 1);
+    steps.push_back(harness::runStep("picture in picture 64x64", display, opt.frames));
+
+    // Mouse-look: a burst of motion events is applied as one turn
+    press('v', 1);
+    press('m', 1);
+    for (int x = 400; x <= 520; x += 4) mouseMotion(x, 300);
+    steps.push_back(harness::runStep("mouse look 64x64", display, opt.frames));
+
+    // Two other racers as a client would see them, on the map and in 3D
+    float others[] = {2.5f, 1.5f, 0.0f, 1.5f, 3.2f, 1.0f};
+    remotePlayers.assign(others, others + 6);
+    playerAngle = 0.0f;
+    steps.push_back(harness::runStep("remote players 64x64", display, opt.frames));
+    press('v', 1);
+    steps.push_back(harness::runStep("remote players split screen", display, opt.frames));
+
+    bool ok = harness::writeJson(opt, "Hw_04", steps);
+    harness::destroyContext();
+    return ok ? 0 : 1;
+}
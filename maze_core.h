@@ -0,0 +1,210 @@
+#ifndef MAZE_CORE_H
+#define MAZE_CORE_H
+
+// The Hw_04 game rules without GL or GLUT: the cell grid, the generator's
+// depth-first walk, movement with wall collisions and the win test. Hw_04
+// and the headless maze_server share them, so a bot in the server moves
+// exactly like a player at the keyboard.
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Cell structure
+struct Cell {
+    bool visited = false;
+    bool walls[4] = {true, true, true, true};  // North, East, South, West
+};
+
+// Cells stored column by column, so maze[x][z] reads like the old 2D array
+class MazeGrid {
+public:
+    MazeGrid(int w = 0, int h = 0) { resize(w, h); }
+
+    void resize(int w, int h) {
+        height = h;
+        cells.assign((size_t)w * h, Cell());
+        data = cells.empty() ? NULL : &cells[0];
+    }
+
+    // w * h cells the caller owns, e.g. in an arena, left as they are
+    void place(Cell *storage, int w, int h) {
+        std::vector<Cell>().swap(cells);
+        height = h;
+        data = storage;
+    }
+
+    Cell *operator[](int x) { return data + (size_t)x * height; }
+    const Cell *operator[](int x) const { return data + (size_t)x * height; }
+
+private:
+    int height;
+    Cell *data;
+    std::vector<Cell> cells;
+};
+
+// Direction vectors (North, East, South, West)
+const int dx[4] = {0, 1, 0, -1};
+const int dz[4] = {-1, 0, 1, 0};
+
+// Input gathered between two simulation ticks
+struct InputState {
+    double turn;   // radians: snap turns and mouse-look
+    int forward;   // 'w'/'s' steps, negative is backward
+    int strafe;    // 'd'/'a' steps, negative is left
+    int lunges;    // middle-button steps
+};
+
+// Closes every cell, then carves a randomized depth-first walk from (1, 1)
+// that leans toward the destination one step in five. bias() rolls that
+// step; Hw_04 passes rand() so seeded mazes do not change. cellStack has
+// room for width * height cells, x * height + z each; nothing else is
+// allocated.
+template <class Bias>
+void carveMaze(MazeGrid &maze, int width, int height, int destX, int destZ, std::mt19937 &gen, Bias bias,
+               uint32_t *cellStack) {
+    using namespace std;
+    size_t top = 0;
+    int startX = 1;
+    int startZ = 1;
+
+    // Initialize all cells as unvisited with all walls intact
+    for (int x = 0; x < width; x++) {
+        for (int z = 0; z < height; z++) {
+            maze[x][z].visited = false;
+            for (int i = 0; i < 4; i++) {
+                maze[x][z].walls[i] = true;
+            }
+        }
+    }
+
+    maze[startX][startZ].visited = true;
+    cellStack[top++] = (uint32_t)(startX * height + startZ);
+
+    while (top) {
+        int x = (int)(cellStack[top - 1] / height);
+        int z = (int)(cellStack[top - 1] % height);
+
+        // Find unvisited neighbors
+        int neighbors[4];
+        int count = 0;
+        for (int i = 0; i < 4; i++) {
+            int nx = x + dx[i];
+            int nz = z + dz[i];
+
+            // Make sure we don't go outside the maze boundaries
+            if (nx >= 0 && nx < width && nz >= 0 && nz < height && !maze[nx][nz].visited) {
+                neighbors[count++] = i;
+            }
+        }
+
+        if (count) {
+            // Randomly choose a neighbor
+            shuffle(neighbors, neighbors + count, gen);
+
+            if (bias() % 5 == 0) {  // 20% chance to bias toward destination
+                // Find any neighbor that gets us closer to destination
+                for (int i = 0; i < count; i++) {
+                    int dir = neighbors[i];
+                    int nx = x + dx[dir];
+                    int nz = z + dz[dir];
+
+                    // Calculate Manhattan distance to destination
+                    int currDist = abs(x - destX) + abs(z - destZ);
+                    int newDist = abs(nx - destX) + abs(nz - destZ);
+
+                    // If this neighbor gets us closer to destination, prioritize it
+                    if (newDist < currDist) {
+                        swap(neighbors[0], neighbors[i]);  // Move this direction to front
+                        break;
+                    }
+                }
+            }
+
+            int nextDir = neighbors[0];
+
+            int nx = x + dx[nextDir];
+            int nz = z + dz[nextDir];
+
+            // Remove the wall between current cell and chosen neighbor; the
+            // bounds check above keeps the outer walls
+            maze[x][z].walls[nextDir] = false;
+            maze[nx][nz].walls[(nextDir + 2) % 4] = false;
+
+            // Mark the neighbor as visited and push it onto the stack
+            maze[nx][nz].visited = true;
+            cellStack[top++] = (uint32_t)(nx * height + nz);
+        } else {
+            // Backtrack if no unvisited neighbors
+            top--;
+        }
+    }
+}
+
+// Moves (x, z) to (newX, newZ) unless a wall of the current cell is in the
+// way. Sliding moves keep the axis that is not blocked; the others move
+// fully or not at all.
+inline void movePlayer(const MazeGrid &maze, int width, int height, float &x, float &z, float newX, float newZ,
+                       bool slide) {
+    if (!(newX > 0 && newX < width && newZ > 0 && newZ < height)) return;
+
+    int cellX = (int)floor(x);
+    int cellZ = (int)floor(z);
+    int newCellX = (int)floor(newX);
+    int newCellZ = (int)floor(newZ);
+    bool blockedX = newCellX != cellX && maze[cellX][cellZ].walls[newCellX > cellX ? 1 : 3];
+    bool blockedZ = newCellZ != cellZ && maze[cellX][cellZ].walls[newCellZ > cellZ ? 2 : 0];
+    if (!slide && (blockedX || blockedZ)) return;
+
+    if (!blockedX) x = newX;
+    if (!blockedZ) z = newZ;
+}
+
+// One simulation tick: turns first, then the steps one at a time so
+// collisions work as per key press
+inline void applyMazeInput(const MazeGrid &maze, int width, int height, float &x, float &z, float &angle,
+                           const InputState &in) {
+    const float moveSpeed = 0.1f;
+    if (in.turn != 0.0) angle += in.turn;
+
+    for (int i = 0; i < abs(in.forward); i++) {
+        float sign = in.forward > 0 ? 1.0f : -1.0f;
+        movePlayer(maze, width, height, x, z, x + sign * cos(angle) * moveSpeed, z + sign * sin(angle) * moveSpeed,
+                   true);
+    }
+    for (int i = 0; i < abs(in.strafe); i++) {
+        double side = in.strafe > 0 ? angle + M_PI / 2 : angle - M_PI / 2;
+        movePlayer(maze, width, height, x, z, x + cos(side) * moveSpeed, z + sin(side) * moveSpeed, true);
+    }
+    for (int i = 0; i < in.lunges; i++) {
+        movePlayer(maze, width, height, x, z, x + cos(angle) * 0.5f, z + sin(angle) * 0.5f, false);
+    }
+}
+
+inline bool atDestination(float x, float z, int destX, int destZ) { return floor(x) == destX && floor(z) == destZ; }
+
+// The walls one bit each, in the order maze_net.h sends them: (height + 1)
+// rows of width horizontal walls, then height rows of width + 1 vertical ones
+inline void packMazeWalls(const MazeGrid &maze, int width, int height, std::vector<uint8_t> &bits) {
+    size_t count = (size_t)(height + 1) * width + (size_t)height * (width + 1);
+    bits.assign((count + 7) / 8, 0);
+
+    size_t vertical = (size_t)(height + 1) * width;
+    for (int x = 0; x < width; x++) {
+        for (int z = 0; z < height; z++) {
+            const Cell &c = maze[x][z];
+            size_t north = (size_t)z * width + x, west = vertical + (size_t)z * (width + 1) + x;
+            bits[north >> 3] |= c.walls[0] << (north & 7);
+            bits[west >> 3] |= c.walls[3] << (west & 7);
+            if (z == height - 1) bits[(north + width) >> 3] |= c.walls[2] << ((north + width) & 7);
+            if (x == width - 1) bits[(west + 1) >> 3] |= c.walls[1] << ((west + 1) & 7);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,654 @@
+#ifndef MAZE_NET_H
+#define MAZE_NET_H
+
+// Localhost multiplayer race for Hw_04. One process hosts: it owns the maze
+// and relays every player's position. The others join over TCP.
+//
+// A joining client gets the maze once, as its seed plus the walls packed
+// one bit each, and a snapshot of everyone. After that a tick only carries
+// what changed. Positions are quantized to 1/256 of a cell and angles to
+// 1/65536 of a turn, and each changed field is sent as a zigzag varint
+// delta from its previous value. A player standing still costs nothing and
+// a walking one a few bytes. TCP delivers in order, so both ends always
+// agree on the previous values.
+//
+// Each NET_MAZE carries a generation number, and every NET_STATE echoes the
+// generation of the sender's maze. After a restart the host leaves a client
+// out of the winner test until it reports from the new maze, so a position
+// on the old destination cannot win the new race.
+//
+// Every message is u8 type, u32 payload length (little endian), payload.
+// Include before <windows.h>, which would pull in the old winsock.h.
+
+#include <stdint.h>
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef SOCKET net_socket;
+#define NET_INVALID_SOCKET INVALID_SOCKET
+#else
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int net_socket;
+#define NET_INVALID_SOCKET (-1)
+#endif
+
+#ifdef MSG_NOSIGNAL
+#define NET_SEND_FLAGS MSG_NOSIGNAL  // a closed peer is an error, not SIGPIPE
+#else
+#define NET_SEND_FLAGS 0
+#endif
+
+enum NetMessageType {
+    NET_WELCOME = 1,  // host -> client: varint id
+    NET_MAZE,         // host -> client: NetMaze
+    NET_TICK,         // host -> client: varint tick, varint count, count x (varint id, delta)
+    NET_WINNER,       // host -> client: varint id
+    NET_STATE,        // client -> host: varint maze generation, delta of the sender's own player
+    NET_INPUT         // client -> maze_server: zigzag forward, strafe, turn (1/65536 turn), varint lunges
+};
+
+// What update() saw, as flags
+enum { NET_EVENT_PLAYERS = 1, NET_EVENT_MAZE = 2, NET_EVENT_WINNER = 4 };
+
+// Delta mask bits
+enum { NET_DX = 1, NET_DZ = 2, NET_DANGLE = 4, NET_JOINED = 8, NET_LEFT = 16 };
+
+const int NET_POSITION_SCALE = 256;  // units per cell
+
+struct NetPlayer {
+    int32_t x, z;    // 1/256 cell
+    uint16_t angle;  // 1/65536 turn
+    bool active;
+};
+
+inline NetPlayer netQuantize(float x, float z, float angle) {
+    const double TWO_PI = 6.28318530717958647692;
+    double turns = angle / TWO_PI;
+    NetPlayer p;
+    p.x = (int32_t)floor(x * NET_POSITION_SCALE + 0.5f);
+    p.z = (int32_t)floor(z * NET_POSITION_SCALE + 0.5f);
+    p.angle = (uint16_t)(int32_t)floor((turns - floor(turns)) * 65536.0 + 0.5);
+    p.active = true;
+    return p;
+}
+
+inline float netPlayerX(const NetPlayer &p) { return p.x / (float)NET_POSITION_SCALE; }
+inline float netPlayerZ(const NetPlayer &p) { return p.z / (float)NET_POSITION_SCALE; }
+inline float netPlayerAngle(const NetPlayer &p) { return p.angle * (6.28318530717958647692f / 65536.0f); }
+
+// The host's maze as sent to clients
+struct NetMaze {
+    uint32_t generation = 0;  // numbered by the host, see NetHost::setMaze()
+    uint32_t seed;
+    int width, height;
+    int destX, destZ;
+    std::vector<uint8_t> walls;  // (height + 1) rows of width horizontal walls, then
+                                 // height rows of width + 1 vertical walls, one bit each
+};
+
+inline size_t netWallBits(int width, int height) { return (size_t)(height + 1) * width + (size_t)height * (width + 1); }
+
+struct NetWriter {
+    std::vector<uint8_t> bytes;
+
+    void u8(uint8_t v) { bytes.push_back(v); }
+    void u32(uint32_t v) {
+        for (int i = 0; i < 4; i++) bytes.push_back((uint8_t)(v >> (8 * i)));
+    }
+    void varint(uint32_t v) {
+        while (v >= 0x80) {
+            bytes.push_back((uint8_t)(v | 0x80));
+            v >>= 7;
+        }
+        bytes.push_back((uint8_t)v);
+    }
+    // Small magnitudes of either sign stay short
+    void zigzag(int32_t v) { varint(((uint32_t)v << 1) ^ (uint32_t)(v >> 31)); }
+    void raw(const uint8_t *p, size_t n) { bytes.insert(bytes.end(), p, p + n); }
+
+    // Messages can be queued back to back; end() fills in the length
+    size_t begin(uint8_t type) {
+        u8(type);
+        u32(0);
+        return bytes.size();
+    }
+    void end(size_t start) {
+        uint32_t n = (uint32_t)(bytes.size() - start);
+        for (int i = 0; i < 4; i++) bytes[start - 4 + i] = (uint8_t)(n >> (8 * i));
+    }
+};
+
+// Reads past the end return zeros and clear ok
+struct NetReader {
+    const uint8_t *p;
+    const uint8_t *end;
+    bool ok;
+
+    NetReader(const uint8_t *data = 0, size_t n = 0) : p(data), end(data + n), ok(true) {}
+
+    uint8_t u8() {
+        if (p >= end) return fail();
+        return *p++;
+    }
+    uint32_t u32() {
+        uint32_t v = 0;
+        for (int i = 0; i < 4; i++) v |= (uint32_t)u8() << (8 * i);
+        return v;
+    }
+    uint32_t varint() {
+        uint32_t v = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            uint8_t b = u8();
+            v |= (uint32_t)(b & 0x7f) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        return fail();
+    }
+    int32_t zigzag() {
+        uint32_t v = varint();
+        return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+    }
+    bool raw(uint8_t *out, size_t n) {
+        if ((size_t)(end - p) < n) return fail() != 0;
+        memcpy(out, p, n);
+        p += n;
+        return true;
+    }
+
+private:
+    uint8_t fail() {
+        ok = false;
+        p = end;
+        return 0;
+    }
+};
+
+inline uint8_t netDeltaMask(const NetPlayer &prev, const NetPlayer &cur) {
+    if (prev.active && !cur.active) return NET_LEFT;
+    if (!cur.active) return 0;
+    uint8_t mask = prev.active ? 0 : NET_JOINED;
+    if (cur.x != prev.x) mask |= NET_DX;
+    if (cur.z != prev.z) mask |= NET_DZ;
+    if (cur.angle != prev.angle) mask |= NET_DANGLE;
+    return mask;
+}
+
+inline void netWriteDelta(NetWriter &w, uint8_t mask, const NetPlayer &prev, const NetPlayer &cur) {
+    w.u8(mask);
+    if (mask & NET_DX) w.zigzag(cur.x - prev.x);
+    if (mask & NET_DZ) w.zigzag(cur.z - prev.z);
+    if (mask & NET_DANGLE) w.zigzag((int16_t)(uint16_t)(cur.angle - prev.angle));
+}
+
+// A player that left goes back to the all-zero state a join starts from
+inline void netReadDelta(NetReader &r, NetPlayer &p) {
+    uint8_t mask = r.u8();
+    if (mask & NET_LEFT) {
+        memset(&p, 0, sizeof(p));
+        return;
+    }
+    if (mask & NET_JOINED) p.active = true;
+    if (mask & NET_DX) p.x += r.zigzag();
+    if (mask & NET_DZ) p.z += r.zigzag();
+    if (mask & NET_DANGLE) p.angle = (uint16_t)(p.angle + r.zigzag());
+}
+
+inline void netWriteMaze(NetWriter &w, const NetMaze &m) {
+    size_t start = w.begin(NET_MAZE);
+    w.varint(m.generation);
+    w.u32(m.seed);
+    w.varint(m.width);
+    w.varint(m.height);
+    w.varint(m.destX);
+    w.varint(m.destZ);
+    w.raw(m.walls.empty() ? 0 : &m.walls[0], m.walls.size());
+    w.end(start);
+}
+
+inline bool netReadMaze(NetReader &r, NetMaze &m) {
+    m.generation = r.varint();
+    m.seed = r.u32();
+    m.width = r.varint();
+    m.height = r.varint();
+    m.destX = r.varint();
+    m.destZ = r.varint();
+    if (!r.ok || m.width <= 0 || m.height <= 0) return false;
+    m.walls.resize((netWallBits(m.width, m.height) + 7) / 8);
+    return r.raw(&m.walls[0], m.walls.size());
+}
+
+// Every player that differs from base, in one NET_TICK message
+inline void netWriteTick(NetWriter &w, uint32_t tick, const std::vector<NetPlayer> &base,
+                         const std::vector<NetPlayer> &cur) {
+    std::vector<uint8_t> masks(cur.size());
+    uint32_t count = 0;
+    for (size_t i = 0; i < cur.size(); i++) {
+        masks[i] = netDeltaMask(base[i], cur[i]);
+        count += masks[i] != 0;
+    }
+    size_t start = w.begin(NET_TICK);
+    w.varint(tick);
+    w.varint(count);
+    for (size_t i = 0; i < cur.size(); i++) {
+        if (!masks[i]) continue;
+        w.varint((uint32_t)i);
+        netWriteDelta(w, masks[i], base[i], cur[i]);
+    }
+    w.end(start);
+}
+
+inline void netClose(net_socket s) {
+#ifdef _WIN32
+    closesocket(s);
+#else
+    close(s);
+#endif
+}
+
+inline bool netWouldBlock() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+inline void netConfigure(net_socket s) {
+#ifdef _WIN32
+    u_long on = 1;
+    ioctlsocket(s, FIONBIO, &on);
+#else
+    fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+#endif
+    // Ticks are small and latency matters more than packet count
+    int noDelay = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char *)&noDelay, sizeof(noDelay));
+}
+
+inline bool netStartup() {
+#ifdef _WIN32
+    static bool started = false;
+    WSADATA data;
+    if (!started) started = WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    return started;
+#else
+    return true;
+#endif
+}
+
+inline sockaddr_in netLoopback(int port) {
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((uint16_t)port);
+    return addr;
+}
+
+// One TCP stream with its partial input and unsent output
+struct NetConnection {
+    net_socket socket;
+    std::vector<uint8_t> in;  // only grows, the bytes past inEnd are room for recv()
+    size_t inRead;            // bytes of `in` already returned by next()
+    size_t inEnd;             // bytes of `in` received
+    NetWriter out;
+    bool closed;
+    long bytesSent;
+    long bytesReceived;
+
+    NetConnection()
+        : socket(NET_INVALID_SOCKET), inRead(0), inEnd(0), closed(false), bytesSent(0), bytesReceived(0) {}
+
+    // As much as the socket takes now, the rest on the next call
+    void flush() {
+        size_t done = 0;
+        while (!closed && done < out.bytes.size()) {
+            int n = send(socket, (const char *)&out.bytes[done], (int)(out.bytes.size() - done), NET_SEND_FLAGS);
+            if (n > 0) {
+                done += n;
+            } else {
+                if (n < 0 && netWouldBlock()) break;
+                closed = true;
+            }
+        }
+        bytesSent += done;
+        out.bytes.erase(out.bytes.begin(), out.bytes.begin() + done);
+    }
+
+    // Everything available; invalidates readers from earlier next() calls
+    void receive() {
+        if (inRead) {
+            memmove(&in[0], &in[inRead], inEnd - inRead);
+            inEnd -= inRead;
+            inRead = 0;
+        }
+        while (!closed) {
+            if (in.size() - inEnd < 65536) in.resize(inEnd + 65536);
+            int n = recv(socket, (char *)&in[inEnd], 65536, 0);
+            if (n > 0) {
+                inEnd += n;
+                bytesReceived += n;
+            } else {
+                if (n < 0 && netWouldBlock()) break;
+                closed = true;
+            }
+        }
+    }
+
+    // The next complete message, false if none is buffered
+    bool next(uint8_t &type, NetReader &payload) {
+        if (inEnd - inRead < 5) return false;
+        const uint8_t *p = &in[inRead];
+        uint32_t n = p[1] | p[2] << 8 | p[3] << 16 | (uint32_t)p[4] << 24;
+        if (inEnd - inRead - 5 < n) return false;
+        type = p[0];
+        payload = NetReader(p + 5, n);
+        inRead += 5 + n;
+        return true;
+    }
+};
+
+// The authoritative side. Player 0 is the host's own and is set by the
+// caller before each update(); it stays inactive on a relay-only host.
+class NetHost {
+public:
+    std::vector<NetPlayer> players;
+    int winner;  // first player on the destination, -1 while racing
+    long bytesSent;
+    long bytesReceived;
+
+    NetHost() : winner(-1), bytesSent(0), bytesReceived(0), listener(NET_INVALID_SOCKET), generation(0), tick(0), boundPort(0) {
+        players.resize(1);
+        memset(&players[0], 0, sizeof(NetPlayer));
+    }
+
+    ~NetHost() {
+        for (size_t i = 0; i < clients.size(); i++) netClose(clients[i].conn.socket);
+        if (listener != NET_INVALID_SOCKET) netClose(listener);
+    }
+
+    // Loopback only; port 0 picks a free one, see port()
+    bool listen(int port) {
+        if (!netStartup()) return false;
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        if (listener == NET_INVALID_SOCKET) return false;
+        int reuse = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char *)&reuse, sizeof(reuse));
+        sockaddr_in addr = netLoopback(port);
+        socklen_t len = sizeof(addr);
+        if (bind(listener, (sockaddr *)&addr, sizeof(addr)) != 0 || ::listen(listener, SOMAXCONN) != 0 ||
+            getsockname(listener, (sockaddr *)&addr, &len) != 0) {
+            return false;
+        }
+        boundPort = ntohs(addr.sin_port);
+        netConfigure(listener);
+        return true;
+    }
+
+    int port() const { return boundPort; }
+    size_t clientCount() const { return clients.size(); }
+    uint32_t lastTick() const { return tick; }  // of the last broadcast
+
+    // A new race: the maze goes to everyone and the winner is cleared. It
+    // gets the next generation, so every client stays out of the race until
+    // it reports from this maze.
+    void setMaze(const NetMaze &m) {
+        maze = m;
+        maze.generation = ++generation;
+        mazeMessage.bytes.clear();
+        netWriteMaze(mazeMessage, maze);
+        winner = -1;
+        for (size_t i = 0; i < clients.size(); i++) {
+            clients[i].conn.out.raw(&mazeMessage.bytes[0], mazeMessage.bytes.size());
+        }
+    }
+
+    // Accepts new clients, applies their states, announces a winner and
+    // broadcasts this tick's deltas. Returns NET_EVENT_* flags.
+    int update() {
+        int events = 0;
+        acceptClients();
+
+        for (size_t i = 0; i < clients.size();) {
+            Client &c = clients[i];
+            long before = c.conn.bytesReceived;
+            c.conn.receive();
+            bytesReceived += c.conn.bytesReceived - before;
+            uint8_t type;
+            NetReader r;
+            while (c.conn.next(type, r)) {
+                if (type != NET_STATE) continue;
+                c.mazeGeneration = r.varint();
+                netReadDelta(r, c.received);
+                players[c.id] = c.received;
+                events |= NET_EVENT_PLAYERS;
+            }
+            if (c.conn.closed || !r.ok) {
+                drop(i);
+                events |= NET_EVENT_PLAYERS;
+                continue;
+            }
+            i++;
+        }
+
+        if (winner < 0) {
+            for (size_t i = 0; i < players.size(); i++) {
+                const NetPlayer &p = players[i];
+                if (!p.active || p.x / NET_POSITION_SCALE != maze.destX || p.z / NET_POSITION_SCALE != maze.destZ) {
+                    continue;
+                }
+                if (i > 0 && !onCurrentMaze((int)i)) continue;
+                winner = (int)i;
+                NetWriter w;
+                size_t start = w.begin(NET_WINNER);
+                w.varint(winner);
+                w.end(start);
+                queueAll(w);
+                events |= NET_EVENT_WINNER;
+                break;
+            }
+        }
+
+        // One message for everyone, so the cost of encoding does not grow
+        // with the number of receivers
+        sent.resize(players.size());
+        NetWriter w;
+        for (size_t i = 0; i < players.size(); i++) {
+            if (netDeltaMask(sent[i], players[i])) {
+                netWriteTick(w, ++tick, sent, players);
+                sent = players;
+                break;
+            }
+        }
+        if (!w.bytes.empty()) queueAll(w);
+
+        for (size_t i = 0; i < clients.size(); i++) {
+            long before = clients[i].conn.bytesSent;
+            clients[i].conn.flush();
+            bytesSent += clients[i].conn.bytesSent - before;
+        }
+        return events;
+    }
+
+private:
+    struct Client {
+        NetConnection conn;
+        int id;
+        NetPlayer received;       // the client's last state, base of its next delta
+        uint32_t mazeGeneration;  // of the maze that state was on
+    };
+
+    void acceptClients() {
+        if (listener == NET_INVALID_SOCKET) return;
+        for (;;) {
+            net_socket s = accept(listener, 0, 0);
+            if (s == NET_INVALID_SOCKET) break;
+            netConfigure(s);
+
+            Client c;
+            c.conn.socket = s;
+            c.id = freeId();
+            memset(&c.received, 0, sizeof(c.received));
+            c.mazeGeneration = 0;
+            if ((size_t)c.id >= players.size()) {
+                NetPlayer none;
+                memset(&none, 0, sizeof(none));
+                players.resize(c.id + 1, none);
+            }
+
+            // Id, maze, everyone as of the last tick, and the race result
+            NetWriter &w = c.conn.out;
+            size_t start = w.begin(NET_WELCOME);
+            w.varint(c.id);
+            w.end(start);
+            if (!mazeMessage.bytes.empty()) w.raw(&mazeMessage.bytes[0], mazeMessage.bytes.size());
+            std::vector<NetPlayer> none(sent.size());
+            if (!none.empty()) memset(&none[0], 0, none.size() * sizeof(NetPlayer));
+            netWriteTick(w, tick, none, sent);
+            if (winner >= 0) {
+                start = w.begin(NET_WINNER);
+                w.varint(winner);
+                w.end(start);
+            }
+            clients.push_back(c);
+        }
+    }
+
+    int freeId() const {
+        for (int id = 1;; id++) {
+            bool used = false;
+            for (size_t i = 0; i < clients.size() && !used; i++) used = clients[i].id == id;
+            if (!used) return id;
+        }
+    }
+
+    // Whether the client with this id has reported from the current maze
+    bool onCurrentMaze(int id) const {
+        for (size_t i = 0; i < clients.size(); i++) {
+            if (clients[i].id == id) return clients[i].mazeGeneration == maze.generation;
+        }
+        return false;
+    }
+
+    void drop(size_t i) {
+        netClose(clients[i].conn.socket);
+        memset(&players[clients[i].id], 0, sizeof(NetPlayer));
+        clients[i] = clients.back();
+        clients.pop_back();
+    }
+
+    void queueAll(const NetWriter &w) {
+        for (size_t i = 0; i < clients.size(); i++) clients[i].conn.out.raw(&w.bytes[0], w.bytes.size());
+    }
+
+    net_socket listener;
+    std::vector<Client> clients;
+    std::vector<NetPlayer> sent;  // as of the last broadcast
+    NetMaze maze;
+    NetWriter mazeMessage;
+    uint32_t generation;  // of the last setMaze()
+    uint32_t tick;
+    int boundPort;
+};
+
+class NetClient {
+public:
+    int id;  // -1 until welcomed
+    NetMaze maze;
+    std::vector<NetPlayer> players;  // everyone, as relayed by the host
+    int winner;
+    uint32_t tick;  // of the last NET_TICK received
+
+    NetClient() : id(-1), winner(-1), tick(0), sentGeneration(0) { memset(&lastSent, 0, sizeof(lastSent)); }
+    ~NetClient() {
+        if (conn.socket != NET_INVALID_SOCKET) netClose(conn.socket);
+    }
+
+    bool connect(int port) {
+        if (!netStartup()) return false;
+        conn.socket = socket(AF_INET, SOCK_STREAM, 0);
+        if (conn.socket == NET_INVALID_SOCKET) return false;
+        sockaddr_in addr = netLoopback(port);
+        if (::connect(conn.socket, (sockaddr *)&addr, sizeof(addr)) != 0) return false;
+        netConfigure(conn.socket);
+        return true;
+    }
+
+    bool connected() const { return conn.socket != NET_INVALID_SOCKET && !conn.closed; }
+    const NetConnection &connection() const { return conn; }
+
+    // Everything the host sent since the last call, as NET_EVENT_* flags
+    int update() {
+        int events = 0;
+        conn.receive();
+        uint8_t type;
+        NetReader r;
+        while (conn.next(type, r)) {
+            switch (type) {
+                case NET_WELCOME:
+                    id = r.varint();
+                    break;
+                case NET_MAZE:
+                    if (netReadMaze(r, maze)) events |= NET_EVENT_MAZE;
+                    winner = -1;
+                    break;
+                case NET_TICK: {
+                    tick = r.varint();
+                    uint32_t count = r.varint();
+                    for (uint32_t i = 0; i < count && r.ok; i++) {
+                        uint32_t who = r.varint();
+                        if (who >= players.size()) {
+                            NetPlayer none;
+                            memset(&none, 0, sizeof(none));
+                            players.resize(who + 1, none);
+                        }
+                        netReadDelta(r, players[who]);
+                    }
+                    events |= NET_EVENT_PLAYERS;
+                    break;
+                }
+                case NET_WINNER:
+                    winner = r.varint();
+                    events |= NET_EVENT_WINNER;
+                    break;
+            }
+            if (!r.ok) conn.closed = true;
+        }
+        return events;
+    }
+
+    // The local player, if it changed or a new maze arrived since the last
+    // call. Call it after loading the new maze, so self is on that maze.
+    void send(const NetPlayer &self) {
+        uint8_t mask = netDeltaMask(lastSent, self);
+        if (mask || sentGeneration != maze.generation) {
+            size_t start = conn.out.begin(NET_STATE);
+            conn.out.varint(maze.generation);
+            netWriteDelta(conn.out, mask, lastSent, self);
+            conn.out.end(start);
+            lastSent = self;
+            sentGeneration = maze.generation;
+        }
+        conn.flush();
+    }
+
+private:
+    NetConnection conn;
+    NetPlayer lastSent;
+    uint32_t sentGeneration;  // maze.generation of the last NET_STATE
+};
+
+#endif
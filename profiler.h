@@ -0,0 +1,279 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// Per-frame instrumentation shared by Hw_03 and Hw_04.
+//
+// Draw calls, vertices and render-state changes are counted per named CPU
+// scope (PROFILE_SCOPE("drawMaze") until the end of the block). The last
+// finished frame is shown by drawOverlay(), and every scope also goes into
+// a ring buffer that writeChromeTrace() dumps for chrome://tracing or
+// ui.perfetto.dev. Programs can add their own per-frame values with
+// counter(), shown on one overlay line.
+//
+// Include after the GL/GLUT headers: the counters come from the macros at
+// the bottom, which wrap the GL calls the programs make so the drawing code
+// itself stays unchanged. GL 1.1 has no timer queries, so times are CPU
+// submission times; a frame is the interval between beginFrame() calls.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "text_cache.h"
+
+struct ProfileCounters {
+    long drawCalls;
+    long vertices;
+    long stateChanges;
+};
+
+struct ProfileEvent {
+    const char *name;
+    double startUs;
+    double durationUs;
+    int depth;
+    ProfileCounters counters;  // includes nested scopes
+};
+
+// One row of the overlay: every call of a scope within a frame summed up
+struct ProfileScopeStats {
+    const char *name;
+    int calls;
+    double ms;
+    ProfileCounters counters;
+};
+
+class Profiler {
+public:
+    typedef std::chrono::steady_clock clock_type;
+
+    explicit Profiler(size_t capacity = 16384) : frameMs(0.0), ring(capacity), ringNext(0), ringCount(0) {
+        memset(&totals, 0, sizeof(totals));
+        memset(&frameStart, 0, sizeof(frameStart));
+        memset(&lastFrame, 0, sizeof(lastFrame));
+        epoch = clock_type::now();
+        frameBegin = epoch;
+    }
+
+    void drawCall(long vertices = 0) {
+        totals.drawCalls++;
+        totals.vertices += vertices;
+    }
+    void vertex() { totals.vertices++; }
+    void stateChange() { totals.stateChanges++; }
+
+    // Closes the previous frame; call at the top of display()
+    void beginFrame() {
+        clock_type::time_point now = clock_type::now();
+        frameMs = std::chrono::duration<double, std::milli>(now - frameBegin).count();
+        frameBegin = now;
+        lastFrame = delta(frameStart, totals);
+        frameStart = totals;
+        lastScopes.swap(scopes);
+        scopes.clear();
+        lastValues.swap(values);
+        values.clear();
+    }
+
+    // Named value for the current frame; the name must be a string literal
+    void counter(const char *name, double value) {
+        for (size_t i = 0; i < values.size(); i++) {
+            if (values[i].first == name) {
+                values[i].second = value;
+                return;
+            }
+        }
+        values.push_back(std::make_pair(name, value));
+    }
+
+    void beginScope(const char *name) {
+        OpenScope s;
+        s.name = name;
+        s.start = clock_type::now();
+        s.counters = totals;
+        stack.push_back(s);
+    }
+
+    void endScope() {
+        OpenScope s = stack.back();
+        stack.pop_back();
+        clock_type::time_point now = clock_type::now();
+
+        ProfileEvent &e = ring[ringNext];
+        e.name = s.name;
+        e.startUs = std::chrono::duration<double, std::micro>(s.start - epoch).count();
+        e.durationUs = std::chrono::duration<double, std::micro>(now - s.start).count();
+        e.depth = (int)stack.size();
+        e.counters = delta(s.counters, totals);
+        ringNext = (ringNext + 1) % ring.size();
+        if (ringCount < ring.size()) ringCount++;
+
+        // Names are string literals, so pointer equality is enough
+        for (size_t i = 0; i < scopes.size(); i++) {
+            if (scopes[i].name == s.name) {
+                add(scopes[i], e);
+                return;
+            }
+        }
+        ProfileScopeStats stats;
+        memset(&stats, 0, sizeof(stats));
+        stats.name = s.name;
+        add(stats, e);
+        scopes.push_back(stats);
+    }
+
+    const ProfileCounters &frameCounters() const { return lastFrame; }
+    double frameTimeMs() const { return frameMs; }
+    const std::vector<ProfileScopeStats> &frameScopes() const { return lastScopes; }
+    const std::vector<std::pair<const char *, double> > &frameValues() const { return lastValues; }
+
+    // Text in the top-left corner; leaves matrices and enables as it found them
+    void drawOverlay(int windowHeight) {
+        glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+        glDisable(GL_LIGHTING);
+        glDisable(GL_DEPTH_TEST);
+        glMatrixMode(GL_PROJECTION);
+        glPushMatrix();
+        glLoadIdentity();
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+        glLoadIdentity();
+
+        float lineHeight = 2.0f * 15.0f / (windowHeight > 0 ? windowHeight : 1);
+        float y = 1.0f - lineHeight;
+        char line[160];
+        glColor3f(1.0f, 1.0f, 0.0f);
+        snprintf(line, sizeof(line), "frame %.2f ms  draws %ld  verts %ld  states %ld", frameMs,
+                 lastFrame.drawCalls, lastFrame.vertices, lastFrame.stateChanges);
+        TextCache::draw(text.slot(0, GLUT_BITMAP_9_BY_15, line), -0.97f, y);
+
+        if (!lastValues.empty()) {
+            y -= lineHeight;
+            int used = 0;
+            for (size_t i = 0; i < lastValues.size() && used < (int)sizeof(line); i++) {
+                used += snprintf(line + used, sizeof(line) - used, "%s%s %g", i ? "  " : "", lastValues[i].first,
+                                 lastValues[i].second);
+            }
+            TextCache::draw(text.slot(-1, GLUT_BITMAP_9_BY_15, line), -0.97f, y);
+        }
+
+        for (size_t i = 0; i < lastScopes.size(); i++) {
+            const ProfileScopeStats &s = lastScopes[i];
+            y -= lineHeight;
+            snprintf(line, sizeof(line), "%-16s x%-3d %7.3f ms  draws %ld  verts %ld  states %ld", s.name, s.calls,
+                     s.ms, s.counters.drawCalls, s.counters.vertices, s.counters.stateChanges);
+            TextCache::draw(text.slot((int)i + 1, GLUT_BITMAP_9_BY_15, line), -0.97f, y);
+        }
+
+        glPopMatrix();
+        glMatrixMode(GL_PROJECTION);
+        glPopMatrix();
+        glMatrixMode(GL_MODELVIEW);
+        glPopAttrib();
+    }
+
+    // Chrome trace event format: one complete ("X") event per scope, oldest first
+    bool writeChromeTrace(const char *path) const {
+        FILE *f = fopen(path, "w");
+        if (!f) return false;
+
+        fprintf(f, "{\"traceEvents\": [\n");
+        size_t first = (ringNext + ring.size() - ringCount) % ring.size();
+        for (size_t i = 0; i < ringCount; i++) {
+            const ProfileEvent &e = ring[(first + i) % ring.size()];
+            fprintf(f,
+                    "  {\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": %.3f, \"dur\": %.3f, "
+                    "\"args\": {\"draws\": %ld, \"vertices\": %ld, \"states\": %ld}}%s\n",
+                    e.name, e.startUs, e.durationUs, e.counters.drawCalls, e.counters.vertices,
+                    e.counters.stateChanges, i + 1 < ringCount ? "," : "");
+        }
+        fprintf(f, "], \"displayTimeUnit\": \"ms\"}\n");
+        return fclose(f) == 0;
+    }
+
+private:
+    struct OpenScope {
+        const char *name;
+        clock_type::time_point start;
+        ProfileCounters counters;
+    };
+
+    static ProfileCounters delta(const ProfileCounters &from, const ProfileCounters &to) {
+        ProfileCounters d;
+        d.drawCalls = to.drawCalls - from.drawCalls;
+        d.vertices = to.vertices - from.vertices;
+        d.stateChanges = to.stateChanges - from.stateChanges;
+        return d;
+    }
+
+    static void add(ProfileScopeStats &stats, const ProfileEvent &e) {
+        stats.calls++;
+        stats.ms += e.durationUs / 1000.0;
+        stats.counters.drawCalls += e.counters.drawCalls;
+        stats.counters.vertices += e.counters.vertices;
+        stats.counters.stateChanges += e.counters.stateChanges;
+    }
+
+    ProfileCounters totals;
+    ProfileCounters frameStart;
+    ProfileCounters lastFrame;
+    clock_type::time_point epoch;
+    clock_type::time_point frameBegin;
+    double frameMs;
+
+    std::vector<OpenScope> stack;
+    std::vector<ProfileScopeStats> scopes;
+    std::vector<ProfileScopeStats> lastScopes;
+    std::vector<std::pair<const char *, double> > values;
+    std::vector<std::pair<const char *, double> > lastValues;
+
+    TextCache text;  // one slot per overlay line
+
+    std::vector<ProfileEvent> ring;
+    size_t ringNext;
+    size_t ringCount;
+};
+
+inline Profiler &profiler() {
+    static Profiler instance;
+    return instance;
+}
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char *name) { profiler().beginScope(name); }
+    ~ProfileScope() { profiler().endScope(); }
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope_, __LINE__)(name)
+
+// Counting wrappers. A function-like macro is not expanded inside its own
+// replacement, so each one still calls the real GL function.
+#define glBegin(mode) (profiler().drawCall(), glBegin(mode))
+#define glCallList(list) (profiler().drawCall(), glCallList(list))
+#define glDrawArrays(mode, first, count) (profiler().drawCall(count), glDrawArrays(mode, first, count))
+#define glDrawPixels(width, height, format, type, pixels) \
+    (profiler().drawCall(), glDrawPixels(width, height, format, type, pixels))
+#define glutWireCube(size) (profiler().drawCall(24), glutWireCube(size))
+#define glutSolidSphere(radius, slices, stacks) \
+    (profiler().drawCall(2L * (slices) * ((stacks) + 1)), glutSolidSphere(radius, slices, stacks))
+
+#define glVertex2f(x, y) (profiler().vertex(), glVertex2f(x, y))
+#define glVertex2i(x, y) (profiler().vertex(), glVertex2i(x, y))
+#define glVertex3f(x, y, z) (profiler().vertex(), glVertex3f(x, y, z))
+#define glVertex3d(x, y, z) (profiler().vertex(), glVertex3d(x, y, z))
+
+#define glEnable(cap) (profiler().stateChange(), glEnable(cap))
+#define glDisable(cap) (profiler().stateChange(), glDisable(cap))
+#define glCullFace(mode) (profiler().stateChange(), glCullFace(mode))
+#define glDepthFunc(func) (profiler().stateChange(), glDepthFunc(func))
+#define glShadeModel(mode) (profiler().stateChange(), glShadeModel(mode))
+#define glLineWidth(width) (profiler().stateChange(), glLineWidth(width))
+#define glPointSize(size) (profiler().stateChange(), glPointSize(size))
+#define glLightfv(light, pname, params) (profiler().stateChange(), glLightfv(light, pname, params))
+
+#endif
@@ -0,0 +1,819 @@
+// Headless Hw_04 races for load tests: the game rules from maze_core.h and
+// the protocol from maze_net.h, with no GL or GLUT. Linux only (epoll).
+//
+//   maze_server --port 5555               serve until killed
+//   maze_server --bots 1000 --port 5555   bot clients for a running server
+//   maze_server --bench                   both in one process, at several loads
+//
+// One thread runs the epoll loop: it accepts, reads every socket and fires
+// the tick timer. At each tick the rooms are simulated on a thread pool,
+// which also encodes each room's tick once and sends it to its players.
+// Rooms hold ROOM_PLAYERS racers on their own maze. Bots send NET_INPUT
+// key presses and the server moves them as keyboard() would; Hw_04 --join
+// clients send NET_STATE positions and are trusted, as by an Hw_04 host.
+
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/timerfd.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "maze_core.h"
+#include "maze_net.h"
+
+using namespace std;
+
+const int ROOM_PLAYERS = 16;
+const int SESSION_IN = 256;           // longest client message, with its header
+const int SESSION_OUT = 8192;         // unsent bytes before a session is dropped as too slow
+const int SESSIONS_PER_CHUNK = 1024;
+const int MAX_STEPS = 32;             // per tick and kind, from one client
+const int RESTART_TICKS = 90;         // a new maze this many ticks after a win
+const int MAX_MAZE = 128;             // the join message has to fit SESSION_OUT
+
+double monotonicSeconds() {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+double threadCpuSeconds() {
+    timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// One connected player. Both buffers are inline, so a session costs no
+// allocation beyond its slot in the pool.
+struct Session {
+    int fd;
+    int room;      // -1 while on the free list
+    int id;        // slot in the room, the player id clients see
+    bool dead;     // set by a worker, closed by the event loop
+    bool trusted;  // sends NET_STATE (an Hw_04 client) instead of NET_INPUT
+    bool waiting;  // trusted and no state from the current maze yet
+    float x, z, angle;
+    InputState input;   // NET_INPUT since the last tick
+    NetPlayer reported; // NET_STATE position, base of the client's next delta
+    Session *nextFree;
+    int inLen, outLen;
+    uint8_t in[SESSION_IN];
+    uint8_t out[SESSION_OUT];
+};
+
+// Sessions live in fixed chunks that are never moved or freed, so epoll and
+// the rooms hold plain pointers. Closed sessions go on a free list and are
+// reused before another chunk is allocated.
+class SessionPool {
+public:
+    SessionPool() : freeList(NULL), live(0) {}
+    ~SessionPool() {
+        for (size_t i = 0; i < chunks.size(); i++) delete[] chunks[i];
+    }
+
+    Session *acquire(int fd) {
+        if (!freeList) grow();
+        Session *s = freeList;
+        freeList = s->nextFree;
+        live++;
+        s->fd = fd;
+        s->room = s->id = -1;
+        s->dead = s->trusted = s->waiting = false;
+        s->x = s->z = 1.5f;
+        s->angle = 0.0f;
+        memset(&s->input, 0, sizeof(s->input));
+        memset(&s->reported, 0, sizeof(s->reported));
+        s->inLen = s->outLen = 0;
+        return s;
+    }
+
+    void release(Session *s) {
+        s->room = -1;
+        s->nextFree = freeList;
+        freeList = s;
+        live--;
+    }
+
+    size_t size() const { return live; }
+    size_t capacity() const { return chunks.size() * SESSIONS_PER_CHUNK; }
+
+private:
+    void grow() {
+        Session *chunk = new Session[SESSIONS_PER_CHUNK];
+        chunks.push_back(chunk);
+        for (int i = SESSIONS_PER_CHUNK - 1; i >= 0; i--) {
+            chunk[i].room = -1;
+            chunk[i].nextFree = freeList;
+            freeList = &chunk[i];
+        }
+    }
+
+    vector<Session *> chunks;
+    Session *freeList;
+    size_t live;
+};
+
+// Runs one job on every worker and waits for all of them. The threads live
+// as long as the pool, so a tick costs a wake-up instead of a thread start.
+class TickPool {
+public:
+    explicit TickPool(int n) : job(NULL), generation(0), pending(0), quit(false), cpu(n, 0.0) {
+        for (int i = 0; i < n; i++) threads.push_back(thread(&TickPool::work, this, i));
+    }
+
+    ~TickPool() {
+        {
+            lock_guard<mutex> lock(m);
+            quit = true;
+        }
+        wake.notify_all();
+        for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+    }
+
+    int size() const { return (int)threads.size(); }
+
+    void run(const function<void(int)> &f) {
+        unique_lock<mutex> lock(m);
+        job = &f;
+        pending = (int)threads.size();
+        generation++;
+        wake.notify_all();
+        done.wait(lock, [this] { return pending == 0; });
+    }
+
+    // CPU time the workers spent in jobs so far
+    double cpuSeconds() const {
+        double sum = 0.0;
+        for (size_t i = 0; i < cpu.size(); i++) sum += cpu[i];
+        return sum;
+    }
+
+private:
+    void work(int index) {
+        unsigned seen = 0;
+        for (;;) {
+            const function<void(int)> *f;
+            {
+                unique_lock<mutex> lock(m);
+                wake.wait(lock, [&] { return quit || generation != seen; });
+                if (quit) return;
+                seen = generation;
+                f = job;
+            }
+            double start = threadCpuSeconds();
+            (*f)(index);
+            double spent = threadCpuSeconds() - start;
+            lock_guard<mutex> lock(m);
+            cpu[index] += spent;
+            if (--pending == 0) done.notify_one();
+        }
+    }
+
+    vector<thread> threads;
+    mutex m;
+    condition_variable wake, done;
+    const function<void(int)> *job;
+    unsigned generation;
+    int pending;
+    bool quit;
+    vector<double> cpu;
+};
+
+// The DFS bias roll, from the room's own generator instead of rand()
+struct RoomBias {
+    mt19937 *gen;
+    int operator()() const { return (int)((*gen)() >> 1); }
+};
+
+struct Room {
+    int size;
+    MazeGrid maze;
+    int destX, destZ;
+    mt19937 gen;
+    Session *players[ROOM_PLAYERS];
+    int count;
+    int winner;
+    uint32_t restartTick;  // 0 while racing
+    uint32_t generation;   // of the current maze, echoed in NET_STATE
+    vector<uint32_t> carveStack;
+    vector<NetPlayer> sent, cur;
+    NetWriter mazeMessage;  // NET_MAZE of the current maze
+    NetWriter out;          // this tick's messages, the same for everyone
+};
+
+void generateRoomMaze(Room &r, uint32_t seed) {
+    r.gen.seed(seed);
+    r.maze.resize(r.size, r.size);
+    r.destX = r.destZ = r.size - 2;
+    r.carveStack.resize((size_t)r.size * r.size);
+    RoomBias bias = {&r.gen};
+    carveMaze(r.maze, r.size, r.size, r.destX, r.destZ, r.gen, bias, &r.carveStack[0]);
+
+    NetMaze m;
+    m.generation = ++r.generation;
+    m.seed = seed;
+    m.width = m.height = r.size;
+    m.destX = r.destX;
+    m.destZ = r.destZ;
+    packMazeWalls(r.maze, r.size, r.size, m.walls);
+    r.mazeMessage.bytes.clear();
+    netWriteMaze(r.mazeMessage, m);
+    r.winner = -1;
+    r.restartTick = 0;
+}
+
+// Latency of each tick: from its timer deadline until the last room's
+// message was handed to the kernel
+struct TickStats {
+    vector<double> latencyMs;
+    long late;          // deadlines that passed while the previous tick ran
+    double cpuSeconds;  // event loop plus workers
+    double wallSeconds;
+
+    TickStats() : late(0), cpuSeconds(0.0), wallSeconds(0.0) {}
+
+    double percentile(double p) const {
+        if (latencyMs.empty()) return 0.0;
+        vector<double> sorted = latencyMs;
+        sort(sorted.begin(), sorted.end());
+        return sorted[(size_t)(p * (sorted.size() - 1))];
+    }
+};
+
+class MazeServer {
+public:
+    MazeServer(int threads, int mazeSize, int tickMs, uint32_t seed)
+        : pool(threads), mazeSize(mazeSize), tickMs(tickMs), seed(seed), listener(-1), epoll(-1), timer(-1),
+          boundPort(0), tick(0), resetStats(true) {}
+
+    ~MazeServer() {
+        for (size_t i = 0; i < rooms.size(); i++) {
+            for (int j = 0; j < ROOM_PLAYERS; j++) {
+                if (rooms[i]->players[j]) close(rooms[i]->players[j]->fd);
+            }
+            delete rooms[i];
+        }
+        if (listener >= 0) close(listener);
+        if (epoll >= 0) close(epoll);
+        if (timer >= 0) close(timer);
+    }
+
+    // Loopback only, like NetHost; port 0 picks a free one
+    bool listen(int port) {
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        if (listener < 0) return false;
+        int reuse = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        sockaddr_in addr = netLoopback(port);
+        socklen_t len = sizeof(addr);
+        if (bind(listener, (sockaddr *)&addr, sizeof(addr)) != 0 || ::listen(listener, SOMAXCONN) != 0 ||
+            getsockname(listener, (sockaddr *)&addr, &len) != 0) {
+            return false;
+        }
+        boundPort = ntohs(addr.sin_port);
+        netConfigure(listener);
+
+        epoll = epoll_create1(0);
+        timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+        if (epoll < 0 || timer < 0) return false;
+        watch(listener, &listener);
+        watch(timer, &timer);
+        return true;
+    }
+
+    int port() const { return boundPort; }
+    size_t sessions() const { return sessionPool.size(); }
+    size_t roomCount() const { return rooms.size(); }
+
+    // Stats restart at the next tick; the bench skips its warm-up this way
+    void restartStats() { resetStats = true; }
+    const TickStats &stats() const { return current; }
+
+    // Serves until stop is set. With reportSeconds > 0 it prints and
+    // restarts the stats that often.
+    void run(const atomic<bool> &stop, double reportSeconds) {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        itimerspec spec;
+        spec.it_interval.tv_sec = tickMs / 1000;
+        spec.it_interval.tv_nsec = (tickMs % 1000) * 1000000L;
+        spec.it_value = now;
+        double start = now.tv_sec + now.tv_nsec * 1e-9;
+        timerfd_settime(timer, TFD_TIMER_ABSTIME, &spec, NULL);
+        uint64_t expirations = 0;
+
+        double statsWall = 0.0, statsCpu = 0.0, statsPool = 0.0;
+        epoll_event events[256];
+        while (!stop) {
+            if (resetStats.exchange(false)) {
+                current = TickStats();
+                statsWall = monotonicSeconds();
+                statsCpu = threadCpuSeconds();
+                statsPool = pool.cpuSeconds();
+            }
+
+            int n = epoll_wait(epoll, events, 256, 100);
+            bool due = false;
+            for (int i = 0; i < n; i++) {
+                void *tag = events[i].data.ptr;
+                if (tag == &listener) {
+                    acceptSessions();
+                } else if (tag == &timer) {
+                    uint64_t count = 0;
+                    if (read(timer, &count, sizeof(count)) == sizeof(count) && count) {
+                        expirations += count;
+                        current.late += (long)count - 1;
+                        due = true;
+                    }
+                } else {
+                    Session *s = (Session *)tag;
+                    if (!s->dead) receive(*s);
+                    if (s->dead) closeSession(s);
+                }
+            }
+            if (!due) continue;
+
+            runTick();
+            double deadline = start + (expirations - 1) * tickMs / 1000.0;
+            current.latencyMs.push_back((monotonicSeconds() - deadline) * 1000.0);
+            current.wallSeconds = monotonicSeconds() - statsWall;
+            current.cpuSeconds = threadCpuSeconds() - statsCpu + pool.cpuSeconds() - statsPool;
+
+            if (reportSeconds > 0 && current.wallSeconds >= reportSeconds) {
+                printStats(cout);
+                resetStats = true;
+            }
+        }
+    }
+
+    void printStats(ostream &os) const {
+        char line[160];
+        snprintf(line, sizeof(line), "%zu sessions in %zu rooms  tick p50 %.2f ms  p99 %.2f ms  late %ld  cores %.2f",
+                 sessions(), roomCount(), current.percentile(0.5), current.percentile(0.99), current.late,
+                 current.wallSeconds > 0 ? current.cpuSeconds / current.wallSeconds : 0.0);
+        os << line << endl;
+    }
+
+private:
+    void watch(int fd, void *tag) {
+        epoll_event e;
+        e.events = EPOLLIN;
+        e.data.ptr = tag;
+        epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &e);
+    }
+
+    // First room with a free slot; a new one when all are full
+    int openRoom() {
+        for (size_t i = 0; i < rooms.size(); i++) {
+            if (rooms[i]->count < ROOM_PLAYERS) return (int)i;
+        }
+        Room *r = new Room;
+        r->size = mazeSize;
+        memset(r->players, 0, sizeof(r->players));
+        r->count = 0;
+        r->generation = 0;
+        NetPlayer none;
+        memset(&none, 0, sizeof(none));
+        r->sent.assign(ROOM_PLAYERS, none);
+        r->cur.assign(ROOM_PLAYERS, none);
+        generateRoomMaze(*r, seed + (uint32_t)rooms.size());
+        rooms.push_back(r);
+        return (int)rooms.size() - 1;
+    }
+
+    void acceptSessions() {
+        for (;;) {
+            int fd = accept(listener, NULL, NULL);
+            if (fd < 0) break;
+            netConfigure(fd);
+
+            int room = openRoom();
+            Room &r = *rooms[room];
+            int id = 0;
+            while (r.players[id]) id++;
+            Session *s = sessionPool.acquire(fd);
+            s->room = room;
+            s->id = id;
+            r.players[id] = s;
+            r.count++;
+
+            // Id, maze, the room as of its last tick, and the race result
+            NetWriter w;
+            size_t start = w.begin(NET_WELCOME);
+            w.varint(id);
+            w.end(start);
+            w.raw(&r.mazeMessage.bytes[0], r.mazeMessage.bytes.size());
+            vector<NetPlayer> none(ROOM_PLAYERS);
+            memset(&none[0], 0, none.size() * sizeof(NetPlayer));
+            netWriteTick(w, tick, none, r.sent);
+            if (r.winner >= 0) {
+                start = w.begin(NET_WINNER);
+                w.varint(r.winner);
+                w.end(start);
+            }
+            queue(*s, &w.bytes[0], w.bytes.size());
+            flush(*s);
+            watch(fd, s);
+            if (s->dead) closeSession(s);
+        }
+    }
+
+    void closeSession(Session *s) {
+        close(s->fd);
+        Room &r = *rooms[s->room];
+        r.players[s->id] = NULL;
+        r.count--;
+        sessionPool.release(s);
+    }
+
+    void receive(Session &s) {
+        for (;;) {
+            int n = recv(s.fd, s.in + s.inLen, SESSION_IN - s.inLen, 0);
+            if (n <= 0) {
+                if (n < 0 && netWouldBlock()) break;
+                s.dead = true;
+                return;
+            }
+            s.inLen += n;
+
+            int pos = 0;
+            while (s.inLen - pos >= 5) {
+                const uint8_t *p = s.in + pos;
+                uint32_t size = p[1] | p[2] << 8 | p[3] << 16 | (uint32_t)p[4] << 24;
+                if (size > SESSION_IN - 5) {
+                    s.dead = true;
+                    return;
+                }
+                if ((uint32_t)(s.inLen - pos - 5) < size) break;
+                NetReader r(p + 5, size);
+                handle(s, p[0], r);
+                if (!r.ok) {
+                    s.dead = true;
+                    return;
+                }
+                pos += 5 + size;
+            }
+            memmove(s.in, s.in + pos, s.inLen - pos);
+            s.inLen -= pos;
+        }
+    }
+
+    void handle(Session &s, uint8_t type, NetReader &r) {
+        if (type == NET_INPUT) {
+            InputState &in = s.input;
+            in.forward = max(-MAX_STEPS, min(MAX_STEPS, in.forward + r.zigzag()));
+            in.strafe = max(-MAX_STEPS, min(MAX_STEPS, in.strafe + r.zigzag()));
+            in.turn += r.zigzag() * (2.0 * M_PI / 65536.0);
+            in.lunges = min(MAX_STEPS, in.lunges + (int)min<uint32_t>(r.varint(), MAX_STEPS));
+        } else if (type == NET_STATE) {
+            // A state sent before the client loaded the new maze keeps it
+            // waiting, or its spot on the old destination would win
+            uint32_t generation = r.varint();
+            netReadDelta(r, s.reported);
+            s.trusted = true;
+            s.waiting = generation != rooms[s.room]->generation;
+        }
+    }
+
+    void runTick() {
+        tick++;
+        int workers = pool.size();
+        pool.run([&](int worker) {
+            for (size_t i = worker; i < rooms.size(); i += workers) simulate(*rooms[i]);
+        });
+
+        // Sessions whose send failed or overflowed
+        for (size_t i = 0; i < rooms.size(); i++) {
+            for (int j = 0; j < ROOM_PLAYERS; j++) {
+                Session *s = rooms[i]->players[j];
+                if (s && s->dead) closeSession(s);
+            }
+        }
+    }
+
+    // One room's tick, on a worker: its own sessions only
+    void simulate(Room &r) {
+        if (!r.count) return;
+        r.out.bytes.clear();
+
+        if (r.restartTick && tick >= r.restartTick) {
+            generateRoomMaze(r, r.gen());
+            r.out.raw(&r.mazeMessage.bytes[0], r.mazeMessage.bytes.size());
+            for (int i = 0; i < ROOM_PLAYERS; i++) {
+                Session *s = r.players[i];
+                if (!s) continue;
+                s->x = s->z = 1.5f;
+                s->angle = 0.0f;
+                s->waiting = s->trusted;
+            }
+        }
+
+        for (int i = 0; i < ROOM_PLAYERS; i++) {
+            Session *s = r.players[i];
+            if (!s) {
+                memset(&r.cur[i], 0, sizeof(NetPlayer));
+                continue;
+            }
+            if (s->trusted && !s->waiting) {
+                s->x = netPlayerX(s->reported);
+                s->z = netPlayerZ(s->reported);
+                s->angle = netPlayerAngle(s->reported);
+            } else if (r.winner < 0) {
+                applyMazeInput(r.maze, r.size, r.size, s->x, s->z, s->angle, s->input);
+            }
+            memset(&s->input, 0, sizeof(s->input));
+            r.cur[i] = netQuantize(s->x, s->z, s->angle);
+
+            if (r.winner < 0 && atDestination(s->x, s->z, r.destX, r.destZ)) {
+                r.winner = i;
+                r.restartTick = tick + RESTART_TICKS;
+                size_t start = r.out.begin(NET_WINNER);
+                r.out.varint(i);
+                r.out.end(start);
+            }
+        }
+
+        for (int i = 0; i < ROOM_PLAYERS; i++) {
+            if (netDeltaMask(r.sent[i], r.cur[i])) {
+                netWriteTick(r.out, tick, r.sent, r.cur);
+                r.sent = r.cur;
+                break;
+            }
+        }
+        if (r.out.bytes.empty()) return;
+
+        for (int i = 0; i < ROOM_PLAYERS; i++) {
+            Session *s = r.players[i];
+            if (!s || s->dead) continue;
+            queue(*s, &r.out.bytes[0], r.out.bytes.size());
+            flush(*s);
+        }
+    }
+
+    // A client that falls SESSION_OUT bytes behind is dropped
+    static void queue(Session &s, const uint8_t *p, size_t n) {
+        if (s.outLen + n > (size_t)SESSION_OUT) {
+            s.dead = true;
+            return;
+        }
+        memcpy(s.out + s.outLen, p, n);
+        s.outLen += (int)n;
+    }
+
+    static void flush(Session &s) {
+        int done = 0;
+        while (!s.dead && done < s.outLen) {
+            int n = send(s.fd, s.out + done, s.outLen - done, NET_SEND_FLAGS);
+            if (n > 0) {
+                done += n;
+            } else if (n < 0 && netWouldBlock()) {
+                break;
+            } else {
+                s.dead = true;
+            }
+        }
+        memmove(s.out, s.out + done, s.outLen - done);
+        s.outLen -= done;
+    }
+
+    SessionPool sessionPool;
+    TickPool pool;
+    vector<Room *> rooms;
+    int mazeSize;
+    int tickMs;
+    uint32_t seed;
+    int listener, epoll, timer;
+    int boundPort;
+    uint32_t tick;
+    atomic<bool> resetStats;
+    TickStats current;
+};
+
+// Load generators: each bot walks like a player holding 'w' and clicking
+// now and then, and discards everything it receives
+class BotSwarm {
+public:
+    long bytesSent, bytesReceived;
+    int closed;
+
+    BotSwarm() : bytesSent(0), bytesReceived(0), closed(0), epoll(epoll_create1(0)) {
+        // One step forward, plus a quarter turn either way one tick in eight
+        const int turns[] = {0, 16384, -16384};
+        for (int i = 0; i < 3; i++) {
+            size_t start = inputs[i].begin(NET_INPUT);
+            inputs[i].zigzag(1);
+            inputs[i].zigzag(0);
+            inputs[i].zigzag(turns[i]);
+            inputs[i].varint(0);
+            inputs[i].end(start);
+        }
+    }
+    ~BotSwarm() {
+        for (size_t i = 0; i < bots.size(); i++) {
+            if (bots[i].fd >= 0) close(bots[i].fd);
+        }
+        close(epoll);
+    }
+
+    bool connect(int port, int count) {
+        bots.reserve(bots.size() + count);
+        for (int i = 0; i < count; i++) {
+            Bot b;
+            b.fd = socket(AF_INET, SOCK_STREAM, 0);
+            b.rng = 2463534242u + (uint32_t)bots.size() * 7919u;
+            sockaddr_in addr = netLoopback(port);
+            if (b.fd < 0 || ::connect(b.fd, (sockaddr *)&addr, sizeof(addr)) != 0) {
+                if (b.fd >= 0) close(b.fd);
+                return false;
+            }
+            netConfigure(b.fd);
+            bots.push_back(b);
+        }
+        for (size_t i = 0; i < bots.size(); i++) {
+            epoll_event e;
+            e.events = EPOLLIN;
+            e.data.u64 = i;
+            epoll_ctl(epoll, EPOLL_CTL_ADD, bots[i].fd, &e);
+        }
+        return true;
+    }
+
+    void run(const atomic<bool> &stop, int tickMs) {
+        vector<epoll_event> events(256);
+        vector<uint8_t> sink(65536);
+        double next = monotonicSeconds();
+        while (!stop) {
+            double now = monotonicSeconds();
+            if (now >= next) {
+                sendInputs();
+                next += tickMs / 1000.0;
+                if (next < now) next = now + tickMs / 1000.0;
+            }
+            int wait = (int)((next - monotonicSeconds()) * 1000.0) + 1;
+            int n = epoll_wait(epoll, &events[0], (int)events.size(), max(0, wait));
+            for (int i = 0; i < n; i++) {
+                Bot &b = bots[events[i].data.u64];
+                for (;;) {
+                    int got = recv(b.fd, &sink[0], (int)sink.size(), 0);
+                    if (got > 0) {
+                        bytesReceived += got;
+                        continue;
+                    }
+                    if (got == 0 || !netWouldBlock()) {
+                        close(b.fd);
+                        b.fd = -1;
+                        closed++;
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+private:
+    struct Bot {
+        int fd;
+        uint32_t rng;
+    };
+
+    // xorshift32: cheap, and each bot keeps its own sequence
+    static uint32_t roll(Bot &b) {
+        b.rng ^= b.rng << 13;
+        b.rng ^= b.rng >> 17;
+        b.rng ^= b.rng << 5;
+        return b.rng;
+    }
+
+    void sendInputs() {
+        for (size_t i = 0; i < bots.size(); i++) {
+            Bot &b = bots[i];
+            if (b.fd < 0) continue;
+            uint32_t r = roll(b) % 16;
+            const NetWriter &w = inputs[r < 2 ? r + 1 : 0];
+            int n = send(b.fd, &w.bytes[0], (int)w.bytes.size(), NET_SEND_FLAGS);
+            if (n > 0) bytesSent += n;
+        }
+    }
+
+    vector<Bot> bots;
+    NetWriter inputs[3];
+    int epoll;
+};
+
+// Server and bots in one process at increasing loads. Only the server's
+// threads count toward its CPU time.
+void bench(int threads, int mazeSize, int tickMs) {
+    const int counts[] = {250, 500, 1000, 2000, 4000};
+    cout << "tick " << tickMs << " ms, " << threads << " worker threads, " << mazeSize << "x" << mazeSize
+         << " mazes, " << ROOM_PLAYERS << " players per room" << endl;
+    cout << "sessions  rooms  p50_ms  p99_ms  max_ms  late  server_cores  sessions_per_core" << endl;
+    for (int k = 0; k < 5; k++) {
+        MazeServer server(threads, mazeSize, tickMs, 1);
+        if (!server.listen(0)) {
+            cout << "Cannot listen" << endl;
+            return;
+        }
+        atomic<bool> stop(false);
+        thread serverThread([&] { server.run(stop, 0.0); });
+        BotSwarm bots;
+        bool connected = bots.connect(server.port(), counts[k]);
+        thread botThread([&] {
+            if (connected) bots.run(stop, tickMs);
+        });
+
+        this_thread::sleep_for(chrono::seconds(1));
+        server.restartStats();
+        this_thread::sleep_for(chrono::seconds(3));
+        stop = true;
+        serverThread.join();
+        botThread.join();
+        if (!connected) {
+            cout << "Cannot connect " << counts[k] << " bots" << endl;
+            return;
+        }
+
+        const TickStats &st = server.stats();
+        double cores = st.wallSeconds > 0 ? st.cpuSeconds / st.wallSeconds : 0.0;
+        char line[160];
+        snprintf(line, sizeof(line), "%8zu  %5zu  %6.2f  %6.2f  %6.2f  %4ld  %12.2f  %17.0f", server.sessions(),
+                 server.roomCount(), st.percentile(0.5), st.percentile(0.99), st.percentile(1.0),
+                 st.late, cores, cores > 0 ? server.sessions() / cores : 0.0);
+        cout << line << endl;
+    }
+}
+
+int main(int argc, char **argv) {
+    int port = 5555, bots = 0, mazeSize = 16, tickMs = 33;
+    int threads = max(1u, thread::hardware_concurrency());
+    uint32_t seed = 1;
+    bool benchMode = false;
+    for (int i = 1; i < argc; i++) {
+        bool more = i + 1 < argc;
+        if (strcmp(argv[i], "--bench") == 0) {
+            benchMode = true;
+        } else if (strcmp(argv[i], "--port") == 0 && more) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bots") == 0 && more) {
+            bots = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && more) {
+            threads = max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--maze") == 0 && more) {
+            mazeSize = max(4, min(MAX_MAZE, atoi(argv[++i])));
+        } else if (strcmp(argv[i], "--tick") == 0 && more) {
+            tickMs = max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--seed") == 0 && more) {
+            seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else {
+            cout << "usage: maze_server [--port N] [--threads N] [--maze N] [--tick MS] [--seed N]\n"
+                    "       maze_server --bots N [--port N] [--tick MS]\n"
+                    "       maze_server --bench [--threads N] [--maze N] [--tick MS]"
+                 << endl;
+            return 1;
+        }
+    }
+
+    // Every session and bot is a descriptor
+    rlimit files;
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0) {
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+    }
+
+    if (benchMode) {
+        bench(threads, mazeSize, tickMs);
+        return 0;
+    }
+
+    atomic<bool> stop(false);
+    if (bots) {
+        BotSwarm swarm;
+        if (!swarm.connect(port, bots)) {
+            cout << "Cannot connect " << bots << " bots to port " << port << endl;
+            return 1;
+        }
+        cout << bots << " bots on port " << port << endl;
+        swarm.run(stop, tickMs);
+        return 0;
+    }
+
+    MazeServer server(threads, mazeSize, tickMs, seed);
+    if (!server.listen(port)) {
+        cout << "Cannot listen on port " << port << endl;
+        return 1;
+    }
+    cout << "Serving " << mazeSize << "x" << mazeSize << " races on port " << server.port() << endl;
+    server.run(stop, 5.0);
+    return 0;
+}
@@ -0,0 +1,970 @@
+#include "softgl.h"
+
+#include <GL/gl.h>
+#include <GL/glu.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const int TILE = 64;
+const float GUARD_BAND = 4.0f;  // x/y clip planes at +-4w, most triangles skip clipping
+
+// Column-major 4x4 matrix, same layout as GL
+struct Mat4 {
+    float m[16];
+};
+
+Mat4 identityMatrix() {
+    Mat4 r;
+    for (int i = 0; i < 16; i++) r.m[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+    return r;
+}
+
+Mat4 multiply(const Mat4 &a, const Mat4 &b) {
+    Mat4 r;
+    for (int col = 0; col < 4; col++) {
+        for (int row = 0; row < 4; row++) {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; k++) sum += a.m[k * 4 + row] * b.m[col * 4 + k];
+            r.m[col * 4 + row] = sum;
+        }
+    }
+    return r;
+}
+
+struct ClipVertex {
+    float x, y, z, w;
+};
+
+enum PrimType { PRIM_CLEAR, PRIM_TRIANGLE, PRIM_LINE, PRIM_POINT };
+
+struct Prim {
+    unsigned char type;
+    unsigned char depthTest;
+    unsigned char depthWrite;
+    unsigned char depthLess;  // GL_LESS, otherwise GL_LEQUAL
+    unsigned char clearColor;
+    unsigned char clearDepth;
+    uint32_t color;
+    float depthValue;  // clear depth
+    float x[3], y[3], z[3];
+    double a[3], b[3], c[3];  // edge functions a * x + b * y + c >= 0 inside
+    float zx, zy, zc;        // depth plane
+    float size;
+    int minX, minY, maxX, maxY;  // inclusive pixel bounds
+};
+
+struct Context {
+    int width, height, stride;
+    std::vector<uint32_t> color;
+    std::vector<float> depth;
+    int threads;
+    int tilesX, tilesY;
+    std::vector<Prim> prims;
+    std::vector<std::vector<int> > bins;
+
+    GLenum matrixMode;
+    std::vector<Mat4> modelview, projection;
+    Mat4 mvp;  // projection * modelview, refreshed at glBegin
+    uint32_t currentColor;
+    uint32_t clearColor;
+    float clearDepth;
+    int vpX, vpY, vpW, vpH;
+    bool depthTest, depthMask, cullFace;
+    GLenum cullMode, frontFace, depthFunc;
+    float lineWidth, pointSize;
+    int packAlignment, unpackAlignment;
+    float rasterX, rasterY;  // window coordinates
+    bool rasterValid;
+
+    GLenum mode;
+    std::vector<ClipVertex> verts;
+    std::vector<uint32_t> vertColors;
+
+    struct Attrib {
+        GLbitfield mask;
+        bool depthTest, cullFace;
+        uint32_t color;
+    };
+    std::vector<Attrib> attribStack;
+
+    GLuint nextList;
+    bool compiling;  // inside glNewList(GL_COMPILE)
+
+    bool vertexArray;
+    GLint vaSize;
+    GLenum vaType;
+    GLsizei vaStride;
+    const void *vaPointer;
+};
+
+Context *ctx = 0;
+
+uint32_t packColor(float r, float g, float b, float a) {
+    // Rounded in double so 0.7f gives 178 like Mesa, not 179
+    int R = (int)(std::min(std::max(r, 0.0f), 1.0f) * 255.0 + 0.5);
+    int G = (int)(std::min(std::max(g, 0.0f), 1.0f) * 255.0 + 0.5);
+    int B = (int)(std::min(std::max(b, 0.0f), 1.0f) * 255.0 + 0.5);
+    int A = (int)(std::min(std::max(a, 0.0f), 1.0f) * 255.0 + 0.5);
+    // Memory order R, G, B, A as glReadPixels(GL_RGBA, GL_UNSIGNED_BYTE) returns it
+    return (uint32_t)R | ((uint32_t)G << 8) | ((uint32_t)B << 16) | ((uint32_t)A << 24);
+}
+
+Mat4 &currentMatrix() {
+    return ctx->matrixMode == GL_PROJECTION ? ctx->projection.back() : ctx->modelview.back();
+}
+
+void multCurrent(const Mat4 &m) {
+    Mat4 &top = currentMatrix();
+    top = multiply(top, m);
+}
+
+//--------------------------------------------------------------------//
+// Binning
+
+void bin(const Prim &p) {
+    int index = (int)ctx->prims.size();
+    ctx->prims.push_back(p);
+
+    int tx0 = p.minX / TILE, tx1 = p.maxX / TILE;
+    int ty0 = p.minY / TILE, ty1 = p.maxY / TILE;
+    for (int ty = ty0; ty <= ty1; ty++) {
+        for (int tx = tx0; tx <= tx1; tx++) ctx->bins[ty * ctx->tilesX + tx].push_back(index);
+    }
+}
+
+Prim basePrim(PrimType type) {
+    Prim p;
+    memset(&p, 0, sizeof(p));
+    p.type = (unsigned char)type;
+    p.depthTest = ctx->depthTest;
+    p.depthWrite = ctx->depthTest && ctx->depthMask;
+    p.depthLess = ctx->depthFunc == GL_LESS;
+    return p;
+}
+
+// The guard band lets primitives reach past the viewport, so their pixel
+// bounds are cut to it here as GL's x/y clipping would
+bool clampBounds(Prim &p, float x0, float y0, float x1, float y1) {
+    p.minX = std::max(std::max(0, ctx->vpX), (int)floor(x0));
+    p.minY = std::max(std::max(0, ctx->vpY), (int)floor(y0));
+    p.maxX = std::min(std::min(ctx->width, ctx->vpX + ctx->vpW) - 1, (int)ceil(x1));
+    p.maxY = std::min(std::min(ctx->height, ctx->vpY + ctx->vpH) - 1, (int)ceil(y1));
+    return p.minX <= p.maxX && p.minY <= p.maxY;
+}
+
+void toWindow(const ClipVertex &v, float &x, float &y, float &z) {
+    float iw = 1.0f / v.w;
+    x = ctx->vpX + (v.x * iw + 1.0f) * 0.5f * ctx->vpW;
+    y = ctx->vpY + (v.y * iw + 1.0f) * 0.5f * ctx->vpH;
+    z = (v.z * iw + 1.0f) * 0.5f;
+}
+
+//--------------------------------------------------------------------//
+// Clipping in homogeneous space
+
+// Signed distance to clip plane i (inside >= 0)
+float planeDistance(const ClipVertex &v, int plane) {
+    switch (plane) {
+        case 0: return v.z + v.w;                // near
+        case 1: return v.w - v.z;                // far
+        case 2: return GUARD_BAND * v.w + v.x;   // left
+        case 3: return GUARD_BAND * v.w - v.x;   // right
+        case 4: return GUARD_BAND * v.w + v.y;   // bottom
+        default: return GUARD_BAND * v.w - v.y;  // top
+    }
+}
+
+ClipVertex lerp(const ClipVertex &a, const ClipVertex &b, float t) {
+    ClipVertex r;
+    r.x = a.x + (b.x - a.x) * t;
+    r.y = a.y + (b.y - a.y) * t;
+    r.z = a.z + (b.z - a.z) * t;
+    r.w = a.w + (b.w - a.w) * t;
+    return r;
+}
+
+// Vertices are snapped to 1/16 pixel, which makes every edge function
+// value exact in double: two triangles sharing an edge then agree on every
+// pixel center and no cracks open along quad diagonals
+inline float snap(float v) { return floorf(v * 16.0f + 0.5f) / 16.0f; }
+
+void setupTriangle(const ClipVertex &v0, const ClipVertex &v1, const ClipVertex &v2, uint32_t color) {
+    Prim p = basePrim(PRIM_TRIANGLE);
+    p.color = color;
+    toWindow(v0, p.x[0], p.y[0], p.z[0]);
+    toWindow(v1, p.x[1], p.y[1], p.z[1]);
+    toWindow(v2, p.x[2], p.y[2], p.z[2]);
+    for (int i = 0; i < 3; i++) {
+        p.x[i] = snap(p.x[i]);
+        p.y[i] = snap(p.y[i]);
+    }
+
+    double area = ((double)p.x[1] - p.x[0]) * ((double)p.y[2] - p.y[0]) -
+                  ((double)p.x[2] - p.x[0]) * ((double)p.y[1] - p.y[0]);
+    if (area == 0.0) return;
+
+    if (ctx->cullFace) {
+        bool front = (ctx->frontFace == GL_CCW) ? area > 0.0 : area < 0.0;
+        if (ctx->cullMode == GL_FRONT_AND_BACK) return;
+        if (ctx->cullMode == GL_BACK && !front) return;
+        if (ctx->cullMode == GL_FRONT && front) return;
+    }
+
+    // Make the winding counterclockwise so all edge functions are >= 0 inside
+    if (area < 0.0) {
+        std::swap(p.x[1], p.x[2]);
+        std::swap(p.y[1], p.y[2]);
+        std::swap(p.z[1], p.z[2]);
+        area = -area;
+    }
+
+    for (int e = 0; e < 3; e++) {
+        int i = e, j = (e + 1) % 3;
+        p.a[e] = (double)p.y[i] - p.y[j];
+        p.b[e] = (double)p.x[j] - p.x[i];
+        p.c[e] = -(p.a[e] * p.x[i] + p.b[e] * p.y[i]);
+        // Top-left fill rule: pixels centered on any other edge are left to the
+        // neighbour. Edge values are multiples of 1/256, so half a step turns
+        // >= 0 into > 0 without touching anything else
+        bool topLeft = p.a[e] > 0.0 || (p.a[e] == 0.0 && p.b[e] < 0.0);
+        if (!topLeft) p.c[e] -= 1.0 / 512.0;
+    }
+
+    p.zx = (float)(((p.z[1] - p.z[0]) * (p.y[2] - p.y[0]) - (p.z[2] - p.z[0]) * (p.y[1] - p.y[0])) / area);
+    p.zy = (float)(((p.x[1] - p.x[0]) * (p.z[2] - p.z[0]) - (p.x[2] - p.x[0]) * (p.z[1] - p.z[0])) / area);
+    p.zc = p.z[0] - p.zx * p.x[0] - p.zy * p.y[0];
+
+    float minX = std::min(p.x[0], std::min(p.x[1], p.x[2]));
+    float maxX = std::max(p.x[0], std::max(p.x[1], p.x[2]));
+    float minY = std::min(p.y[0], std::min(p.y[1], p.y[2]));
+    float maxY = std::max(p.y[0], std::max(p.y[1], p.y[2]));
+    if (clampBounds(p, minX, minY, maxX, maxY)) bin(p);
+}
+
+void emitTriangle(const ClipVertex &v0, const ClipVertex &v1, const ClipVertex &v2, uint32_t color) {
+    // Fast path: entirely inside every plane
+    unsigned int outside = 0;
+    for (int plane = 0; plane < 6; plane++) {
+        if (planeDistance(v0, plane) < 0.0f || planeDistance(v1, plane) < 0.0f || planeDistance(v2, plane) < 0.0f) {
+            outside |= 1u << plane;
+        }
+    }
+    if (!outside) {
+        setupTriangle(v0, v1, v2, color);
+        return;
+    }
+
+    // Sutherland-Hodgman against the offending planes, then fan
+    ClipVertex bufA[12], bufB[12];
+    ClipVertex *in = bufA, *out = bufB;
+    int count = 3;
+    in[0] = v0;
+    in[1] = v1;
+    in[2] = v2;
+    for (int plane = 0; plane < 6 && count > 0; plane++) {
+        if (!(outside & (1u << plane))) continue;
+        int n = 0;
+        for (int i = 0; i < count; i++) {
+            const ClipVertex &a = in[i];
+            const ClipVertex &b = in[(i + 1) % count];
+            float da = planeDistance(a, plane), db = planeDistance(b, plane);
+            if (da >= 0.0f) out[n++] = a;
+            if ((da >= 0.0f) != (db >= 0.0f)) out[n++] = lerp(a, b, da / (da - db));
+        }
+        count = n;
+        std::swap(in, out);
+    }
+    for (int i = 1; i + 1 < count; i++) setupTriangle(in[0], in[i], in[i + 1], color);
+}
+
+void emitLine(ClipVertex v0, ClipVertex v1, uint32_t color) {
+    // Liang-Barsky in clip space
+    float t0 = 0.0f, t1 = 1.0f;
+    for (int plane = 0; plane < 6; plane++) {
+        float d0 = planeDistance(v0, plane), d1 = planeDistance(v1, plane);
+        if (d0 < 0.0f && d1 < 0.0f) return;
+        if (d0 < 0.0f) t0 = std::max(t0, d0 / (d0 - d1));
+        if (d1 < 0.0f) t1 = std::min(t1, d0 / (d0 - d1));
+    }
+    if (t0 > t1) return;
+    ClipVertex a = lerp(v0, v1, t0), b = lerp(v0, v1, t1);
+
+    Prim p = basePrim(PRIM_LINE);
+    p.color = color;
+    p.size = std::max(1.0f, floorf(ctx->lineWidth + 0.5f));
+    toWindow(a, p.x[0], p.y[0], p.z[0]);
+    toWindow(b, p.x[1], p.y[1], p.z[1]);
+    // 8 subpixel bits like llvmpipe, so lines on pixel edges pick the same side
+    for (int i = 0; i < 2; i++) {
+        p.x[i] = floorf(p.x[i] * 256.0f + 0.5f) / 256.0f;
+        p.y[i] = floorf(p.y[i] * 256.0f + 0.5f) / 256.0f;
+    }
+
+    float pad = p.size / 2.0f + 1.0f;
+    if (clampBounds(p, std::min(p.x[0], p.x[1]) - pad, std::min(p.y[0], p.y[1]) - pad,
+                    std::max(p.x[0], p.x[1]) + pad, std::max(p.y[0], p.y[1]) + pad)) {
+        bin(p);
+    }
+}
+
+void emitPoint(const ClipVertex &v, uint32_t color) {
+    for (int plane = 0; plane < 6; plane++) {
+        if (planeDistance(v, plane) < 0.0f) return;
+    }
+    Prim p = basePrim(PRIM_POINT);
+    p.color = color;
+    p.size = std::max(1.0f, floorf(ctx->pointSize + 0.5f));
+    toWindow(v, p.x[0], p.y[0], p.z[0]);
+    float half = p.size / 2.0f;
+    if (clampBounds(p, p.x[0] - half, p.y[0] - half, p.x[0] + half - 1.0f, p.y[0] + half - 1.0f)) bin(p);
+}
+
+// Turns the vertices collected since glBegin into primitives. Flat shading
+// uses the provoking vertex GL would: the last one, first for GL_POLYGON.
+void assemble() {
+    const std::vector<ClipVertex> &v = ctx->verts;
+    const std::vector<uint32_t> &c = ctx->vertColors;
+    int n = (int)v.size();
+
+    switch (ctx->mode) {
+        case GL_POINTS:
+            for (int i = 0; i < n; i++) emitPoint(v[i], c[i]);
+            break;
+        case GL_LINES:
+            for (int i = 0; i + 1 < n; i += 2) emitLine(v[i], v[i + 1], c[i + 1]);
+            break;
+        case GL_LINE_STRIP:
+        case GL_LINE_LOOP:
+            for (int i = 0; i + 1 < n; i++) emitLine(v[i], v[i + 1], c[i + 1]);
+            if (ctx->mode == GL_LINE_LOOP && n > 2) emitLine(v[n - 1], v[0], c[0]);
+            break;
+        case GL_TRIANGLES:
+            for (int i = 0; i + 2 < n; i += 3) emitTriangle(v[i], v[i + 1], v[i + 2], c[i + 2]);
+            break;
+        case GL_TRIANGLE_STRIP:
+            for (int i = 0; i + 2 < n; i++) {
+                if (i % 2 == 0) {
+                    emitTriangle(v[i], v[i + 1], v[i + 2], c[i + 2]);
+                } else {
+                    emitTriangle(v[i + 1], v[i], v[i + 2], c[i + 2]);
+                }
+            }
+            break;
+        case GL_TRIANGLE_FAN:
+            for (int i = 1; i + 1 < n; i++) emitTriangle(v[0], v[i], v[i + 1], c[i + 1]);
+            break;
+        case GL_QUADS:
+            for (int i = 0; i + 3 < n; i += 4) {
+                emitTriangle(v[i], v[i + 1], v[i + 2], c[i + 3]);
+                emitTriangle(v[i], v[i + 2], v[i + 3], c[i + 3]);
+            }
+            break;
+        case GL_QUAD_STRIP:
+            for (int i = 0; i + 3 < n; i += 2) {
+                emitTriangle(v[i], v[i + 1], v[i + 3], c[i + 3]);
+                emitTriangle(v[i], v[i + 3], v[i + 2], c[i + 3]);
+            }
+            break;
+        case GL_POLYGON:
+            for (int i = 1; i + 1 < n; i++) emitTriangle(v[0], v[i], v[i + 1], c[0]);
+            break;
+    }
+}
+
+//--------------------------------------------------------------------//
+// Tile rasterization
+
+struct TileRect {
+    int x0, y0, x1, y1;  // half-open
+};
+
+void rasterClear(const Prim &p, const TileRect &t) {
+    for (int y = t.y0; y < t.y1; y++) {
+        if (p.clearColor) std::fill(&ctx->color[y * ctx->stride + t.x0], &ctx->color[y * ctx->stride + t.x1], p.color);
+        if (p.clearDepth) {
+            std::fill(&ctx->depth[y * ctx->stride + t.x0], &ctx->depth[y * ctx->stride + t.x1], p.depthValue);
+        }
+    }
+}
+
+inline void plot(const Prim &p, int x, int y, float z) {
+    size_t i = (size_t)y * ctx->stride + x;
+    if (p.depthTest) {
+        float d = ctx->depth[i];
+        if (p.depthLess ? !(z < d) : !(z <= d)) return;
+        if (p.depthWrite) ctx->depth[i] = z;
+    }
+    ctx->color[i] = p.color;
+}
+
+void rasterTriangle(const Prim &p, const TileRect &t) {
+    int x0 = std::max(p.minX, t.x0), x1 = std::min(p.maxX + 1, t.x1);
+    int y0 = std::max(p.minY, t.y0), y1 = std::min(p.maxY + 1, t.y1);
+    if (x0 >= x1 || y0 >= y1) return;
+
+#ifdef __SSE2__
+    // Four pixels per step; tiles start on multiples of 64 and rows are
+    // padded to the tile size, so aligning x down to 4 stays inside the row.
+    // Edge values step exactly in double and only their signs go to float.
+    int xs = x0 & ~3;
+    const __m128 lane = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    const __m128i laneI = _mm_set_epi32(3, 2, 1, 0);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 ZX = _mm_set1_ps(p.zx);
+    const __m128i colorV = _mm_set1_epi32((int)p.color);
+    const __m128i xMin = _mm_set1_epi32(x0 - 1), xMax = _mm_set1_epi32(x1);
+    __m128d stepLo[3], stepHi[3], step4[3];
+    for (int e = 0; e < 3; e++) {
+        stepLo[e] = _mm_set_pd(p.a[e], 0.0);
+        stepHi[e] = _mm_set_pd(3.0 * p.a[e], 2.0 * p.a[e]);
+        step4[e] = _mm_set1_pd(4.0 * p.a[e]);
+    }
+
+    for (int y = y0; y < y1; y++) {
+        double py = y + 0.5;
+        __m128d lo[3], hi[3];
+        for (int e = 0; e < 3; e++) {
+            __m128d row = _mm_set1_pd(p.a[e] * (xs + 0.5) + p.b[e] * py + p.c[e]);
+            lo[e] = _mm_add_pd(row, stepLo[e]);
+            hi[e] = _mm_add_pd(row, stepHi[e]);
+        }
+        __m128 RZ = _mm_set1_ps((float)(p.zy * py + p.zc));
+        uint32_t *crow = &ctx->color[(size_t)y * ctx->stride];
+        float *drow = &ctx->depth[(size_t)y * ctx->stride];
+
+        for (int x = xs; x < x1; x += 4) {
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int e = 0; e < 3; e++) {
+                __m128 v = _mm_movelh_ps(_mm_cvtpd_ps(lo[e]), _mm_cvtpd_ps(hi[e]));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(v, zero));
+                lo[e] = _mm_add_pd(lo[e], step4[e]);
+                hi[e] = _mm_add_pd(hi[e], step4[e]);
+            }
+            __m128i xi = _mm_add_epi32(_mm_set1_epi32(x), laneI);
+            __m128i inRange = _mm_and_si128(_mm_cmpgt_epi32(xi, xMin), _mm_cmplt_epi32(xi, xMax));
+            __m128i mask = _mm_and_si128(_mm_castps_si128(inside), inRange);
+            if (!_mm_movemask_epi8(mask)) continue;
+
+            if (p.depthTest) {
+                __m128 px = _mm_add_ps(_mm_set1_ps(x + 0.5f), lane);
+                __m128 z = _mm_add_ps(_mm_mul_ps(ZX, px), RZ);
+                __m128 d = _mm_loadu_ps(drow + x);
+                __m128 pass = p.depthLess ? _mm_cmplt_ps(z, d) : _mm_cmple_ps(z, d);
+                mask = _mm_and_si128(mask, _mm_castps_si128(pass));
+                if (!_mm_movemask_epi8(mask)) continue;
+                if (p.depthWrite) {
+                    __m128 m = _mm_castsi128_ps(mask);
+                    _mm_storeu_ps(drow + x, _mm_or_ps(_mm_and_ps(m, z), _mm_andnot_ps(m, d)));
+                }
+            }
+
+            __m128i old = _mm_loadu_si128((const __m128i *)(crow + x));
+            _mm_storeu_si128((__m128i *)(crow + x),
+                             _mm_or_si128(_mm_and_si128(mask, colorV), _mm_andnot_si128(mask, old)));
+        }
+    }
+#else
+    for (int y = y0; y < y1; y++) {
+        double py = y + 0.5;
+        for (int x = x0; x < x1; x++) {
+            double px = x + 0.5;
+            if (p.a[0] * px + p.b[0] * py + p.c[0] < 0.0) continue;
+            if (p.a[1] * px + p.b[1] * py + p.c[1] < 0.0) continue;
+            if (p.a[2] * px + p.b[2] * py + p.c[2] < 0.0) continue;
+            plot(p, x, y, (float)(p.zx * px + p.zy * py + p.zc));
+        }
+    }
+#endif
+}
+
+void rasterLine(const Prim &p, const TileRect &t) {
+    float dx = p.x[1] - p.x[0], dy = p.y[1] - p.y[0];
+    bool xMajor = fabs(dx) >= fabs(dy);
+    int width = (int)p.size;
+    int lo = -(width - 1) / 2, hi = width / 2;
+
+    // Walk the major axis one pixel at a time, only over this tile's range
+    float s0 = xMajor ? p.x[0] : p.y[0];
+    float s1 = xMajor ? p.x[1] : p.y[1];
+    float ds = s1 - s0;
+    int first = (int)floor(std::min(s0, s1));
+    int last = (int)floor(std::max(s0, s1));
+    first = std::max(first, xMajor ? t.x0 : t.y0);
+    last = std::min(last, (xMajor ? t.x1 : t.y1) - 1);
+
+    for (int i = first; i <= last; i++) {
+        float u = (ds != 0.0f) ? (i + 0.5f - s0) / ds : 0.0f;
+        u = std::min(std::max(u, 0.0f), 1.0f);
+        float z = p.z[0] + (p.z[1] - p.z[0]) * u;
+        // A line exactly on a pixel edge lands on the lower pixel, as in Mesa
+        int minor = (int)ceil(xMajor ? p.y[0] + dy * u : p.x[0] + dx * u) - 1;
+        for (int k = lo; k <= hi; k++) {
+            int m = minor + k;
+            int x = xMajor ? i : m;
+            int y = xMajor ? m : i;
+            if (x < t.x0 || x >= t.x1 || y < t.y0 || y >= t.y1) continue;
+            if (x < p.minX || x > p.maxX || y < p.minY || y > p.maxY) continue;
+            plot(p, x, y, z);
+        }
+    }
+}
+
+void rasterPoint(const Prim &p, const TileRect &t) {
+    int x0 = std::max(p.minX, t.x0), x1 = std::min(p.maxX + 1, t.x1);
+    int y0 = std::max(p.minY, t.y0), y1 = std::min(p.maxY + 1, t.y1);
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) plot(p, x, y, p.z[0]);
+    }
+}
+
+void rasterTile(int tile) {
+    TileRect t;
+    t.x0 = (tile % ctx->tilesX) * TILE;
+    t.y0 = (tile / ctx->tilesX) * TILE;
+    t.x1 = std::min(t.x0 + TILE, ctx->width);
+    t.y1 = std::min(t.y0 + TILE, ctx->height);
+
+    const std::vector<int> &list = ctx->bins[tile];
+    for (size_t k = 0; k < list.size(); k++) {
+        const Prim &p = ctx->prims[list[k]];
+        switch (p.type) {
+            case PRIM_CLEAR: rasterClear(p, t); break;
+            case PRIM_TRIANGLE: rasterTriangle(p, t); break;
+            case PRIM_LINE: rasterLine(p, t); break;
+            case PRIM_POINT: rasterPoint(p, t); break;
+        }
+    }
+}
+
+// Rasterizes everything binned so far; tiles are independent, so workers
+// pull them from a shared counter
+void flush() {
+    if (!ctx || ctx->prims.empty()) return;
+
+    int tiles = ctx->tilesX * ctx->tilesY;
+    std::atomic<int> next(0);
+    struct Worker {
+        static void run(std::atomic<int> *next, int tiles) {
+            for (int tile = (*next)++; tile < tiles; tile = (*next)++) {
+                if (!ctx->bins[tile].empty()) rasterTile(tile);
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int i = 1; i < ctx->threads; i++) pool.push_back(std::thread(Worker::run, &next, tiles));
+    Worker::run(&next, tiles);
+    for (size_t i = 0; i < pool.size(); i++) pool[i].join();
+
+    ctx->prims.clear();
+    for (int i = 0; i < tiles; i++) ctx->bins[i].clear();
+}
+
+void vertex(float x, float y, float z, float w) {
+    const float *m = ctx->mvp.m;
+    ClipVertex v;
+    v.x = m[0] * x + m[4] * y + m[8] * z + m[12] * w;
+    v.y = m[1] * x + m[5] * y + m[9] * z + m[13] * w;
+    v.z = m[2] * x + m[6] * y + m[10] * z + m[14] * w;
+    v.w = m[3] * x + m[7] * y + m[11] * z + m[15] * w;
+    ctx->verts.push_back(v);
+    ctx->vertColors.push_back(ctx->currentColor);
+}
+
+}  // namespace
+
+bool softglCreateContext(int width, int height, int threads) {
+    softglDestroyContext();
+    if (width <= 0 || height <= 0) return false;
+
+    ctx = new Context();
+    ctx->width = width;
+    ctx->height = height;
+    ctx->tilesX = (width + TILE - 1) / TILE;
+    ctx->tilesY = (height + TILE - 1) / TILE;
+    ctx->stride = ctx->tilesX * TILE;
+    ctx->color.assign((size_t)ctx->stride * height, 0);
+    ctx->depth.assign((size_t)ctx->stride * height, 1.0f);
+    ctx->bins.resize(ctx->tilesX * ctx->tilesY);
+    ctx->threads = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+
+    ctx->matrixMode = GL_MODELVIEW;
+    ctx->modelview.assign(1, identityMatrix());
+    ctx->projection.assign(1, identityMatrix());
+    ctx->mvp = identityMatrix();
+    ctx->currentColor = packColor(1.0f, 1.0f, 1.0f, 1.0f);
+    ctx->clearColor = packColor(0.0f, 0.0f, 0.0f, 0.0f);
+    ctx->clearDepth = 1.0f;
+    ctx->vpX = ctx->vpY = 0;
+    ctx->vpW = width;
+    ctx->vpH = height;
+    ctx->depthTest = false;
+    ctx->depthMask = true;
+    ctx->cullFace = false;
+    ctx->cullMode = GL_BACK;
+    ctx->frontFace = GL_CCW;
+    ctx->depthFunc = GL_LESS;
+    ctx->lineWidth = 1.0f;
+    ctx->pointSize = 1.0f;
+    ctx->packAlignment = 4;
+    ctx->unpackAlignment = 4;
+    ctx->rasterX = ctx->rasterY = 0.0f;
+    ctx->rasterValid = true;
+    ctx->mode = GL_POINTS;
+    ctx->nextList = 1;
+    ctx->compiling = false;
+    ctx->vertexArray = false;
+    ctx->vaSize = 4;
+    ctx->vaType = GL_FLOAT;
+    ctx->vaStride = 0;
+    ctx->vaPointer = 0;
+    return true;
+}
+
+void softglDestroyContext() {
+    delete ctx;
+    ctx = 0;
+}
+
+//--------------------------------------------------------------------//
+// GL entry points
+
+extern "C" {
+
+void glClearColor(GLclampf r, GLclampf g, GLclampf b, GLclampf a) { ctx->clearColor = packColor(r, g, b, a); }
+void glClearDepth(GLclampd depth) { ctx->clearDepth = (float)depth; }
+
+void glClear(GLbitfield mask) {
+    Prim p = basePrim(PRIM_CLEAR);
+    p.clearColor = (mask & GL_COLOR_BUFFER_BIT) != 0;
+    p.clearDepth = (mask & GL_DEPTH_BUFFER_BIT) != 0;
+    p.color = ctx->clearColor;
+    p.depthValue = ctx->clearDepth;
+    p.minX = p.minY = 0;
+    p.maxX = ctx->width - 1;
+    p.maxY = ctx->height - 1;
+    bin(p);
+}
+
+void glColor3f(GLfloat r, GLfloat g, GLfloat b) { ctx->currentColor = packColor(r, g, b, 1.0f); }
+void glColor3d(GLdouble r, GLdouble g, GLdouble b) { glColor3f((float)r, (float)g, (float)b); }
+void glColor4f(GLfloat r, GLfloat g, GLfloat b, GLfloat a) { ctx->currentColor = packColor(r, g, b, a); }
+void glColor3ub(GLubyte r, GLubyte g, GLubyte b) { glColor3f(r / 255.0f, g / 255.0f, b / 255.0f); }
+
+void glBegin(GLenum mode) {
+    ctx->mode = mode;
+    ctx->verts.clear();
+    ctx->vertColors.clear();
+    ctx->mvp = multiply(ctx->projection.back(), ctx->modelview.back());
+}
+
+void glEnd(void) {
+    if (!ctx->compiling) assemble();
+}
+
+void glVertex2f(GLfloat x, GLfloat y) { vertex(x, y, 0.0f, 1.0f); }
+void glVertex2i(GLint x, GLint y) { vertex((float)x, (float)y, 0.0f, 1.0f); }
+void glVertex2d(GLdouble x, GLdouble y) { vertex((float)x, (float)y, 0.0f, 1.0f); }
+void glVertex3f(GLfloat x, GLfloat y, GLfloat z) { vertex(x, y, z, 1.0f); }
+void glVertex3d(GLdouble x, GLdouble y, GLdouble z) { vertex((float)x, (float)y, (float)z, 1.0f); }
+void glNormal3f(GLfloat, GLfloat, GLfloat) {}
+void glNormal3d(GLdouble, GLdouble, GLdouble) {}
+
+void glEnableClientState(GLenum array) {
+    if (array == GL_VERTEX_ARRAY) ctx->vertexArray = true;
+}
+void glDisableClientState(GLenum array) {
+    if (array == GL_VERTEX_ARRAY) ctx->vertexArray = false;
+}
+void glVertexPointer(GLint size, GLenum type, GLsizei stride, const GLvoid *pointer) {
+    ctx->vaSize = size;
+    ctx->vaType = type;
+    ctx->vaStride = stride;
+    ctx->vaPointer = pointer;
+}
+
+void glDrawArrays(GLenum mode, GLint first, GLsizei count) {
+    if (!ctx->vertexArray || !ctx->vaPointer) return;
+    size_t elem = ctx->vaType == GL_DOUBLE ? sizeof(double) : sizeof(float);
+    size_t stride = ctx->vaStride ? ctx->vaStride : ctx->vaSize * elem;
+    const unsigned char *base = (const unsigned char *)ctx->vaPointer;
+
+    glBegin(mode);
+    ctx->verts.reserve(count);
+    ctx->vertColors.reserve(count);
+    for (GLsizei i = 0; i < count; i++) {
+        const unsigned char *p = base + (first + i) * stride;
+        float c[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+        for (int k = 0; k < ctx->vaSize && k < 4; k++) {
+            c[k] = ctx->vaType == GL_DOUBLE ? (float)((const double *)p)[k] : ((const float *)p)[k];
+        }
+        vertex(c[0], c[1], c[2], c[3]);
+    }
+    glEnd();
+}
+
+void glMatrixMode(GLenum mode) { ctx->matrixMode = mode; }
+void glLoadIdentity(void) { currentMatrix() = identityMatrix(); }
+void glLoadMatrixf(const GLfloat *m) { memcpy(currentMatrix().m, m, sizeof(float) * 16); }
+void glMultMatrixf(const GLfloat *m) {
+    Mat4 r;
+    memcpy(r.m, m, sizeof(float) * 16);
+    multCurrent(r);
+}
+
+void glPushMatrix(void) {
+    std::vector<Mat4> &stack = ctx->matrixMode == GL_PROJECTION ? ctx->projection : ctx->modelview;
+    stack.push_back(stack.back());
+}
+
+void glPopMatrix(void) {
+    std::vector<Mat4> &stack = ctx->matrixMode == GL_PROJECTION ? ctx->projection : ctx->modelview;
+    if (stack.size() > 1) stack.pop_back();
+}
+
+void glTranslatef(GLfloat x, GLfloat y, GLfloat z) {
+    Mat4 t = identityMatrix();
+    t.m[12] = x;
+    t.m[13] = y;
+    t.m[14] = z;
+    multCurrent(t);
+}
+
+void glScalef(GLfloat x, GLfloat y, GLfloat z) {
+    Mat4 s = identityMatrix();
+    s.m[0] = x;
+    s.m[5] = y;
+    s.m[10] = z;
+    multCurrent(s);
+}
+
+void glRotatef(GLfloat angle, GLfloat x, GLfloat y, GLfloat z) {
+    float len = sqrt(x * x + y * y + z * z);
+    if (len == 0.0f) return;
+    x /= len;
+    y /= len;
+    z /= len;
+    float rad = angle * 3.14159265358979f / 180.0f;
+    float c = cos(rad), s = sin(rad), t = 1.0f - c;
+
+    Mat4 r = identityMatrix();
+    r.m[0] = x * x * t + c;
+    r.m[1] = y * x * t + z * s;
+    r.m[2] = x * z * t - y * s;
+    r.m[4] = x * y * t - z * s;
+    r.m[5] = y * y * t + c;
+    r.m[6] = y * z * t + x * s;
+    r.m[8] = x * z * t + y * s;
+    r.m[9] = y * z * t - x * s;
+    r.m[10] = z * z * t + c;
+    multCurrent(r);
+}
+
+void glOrtho(GLdouble l, GLdouble r, GLdouble b, GLdouble t, GLdouble n, GLdouble f) {
+    Mat4 o = identityMatrix();
+    o.m[0] = (float)(2.0 / (r - l));
+    o.m[5] = (float)(2.0 / (t - b));
+    o.m[10] = (float)(-2.0 / (f - n));
+    o.m[12] = (float)(-(r + l) / (r - l));
+    o.m[13] = (float)(-(t + b) / (t - b));
+    o.m[14] = (float)(-(f + n) / (f - n));
+    multCurrent(o);
+}
+
+void gluOrtho2D(GLdouble l, GLdouble r, GLdouble b, GLdouble t) { glOrtho(l, r, b, t, -1.0, 1.0); }
+
+void gluPerspective(GLdouble fovy, GLdouble aspect, GLdouble n, GLdouble f) {
+    double cot = 1.0 / tan(fovy * 3.14159265358979323846 / 360.0);
+    Mat4 p;
+    memset(p.m, 0, sizeof(p.m));
+    p.m[0] = (float)(cot / aspect);
+    p.m[5] = (float)cot;
+    p.m[10] = (float)((f + n) / (n - f));
+    p.m[11] = -1.0f;
+    p.m[14] = (float)(2.0 * f * n / (n - f));
+    multCurrent(p);
+}
+
+void gluLookAt(GLdouble ex, GLdouble ey, GLdouble ez, GLdouble cx, GLdouble cy, GLdouble cz, GLdouble ux,
+               GLdouble uy, GLdouble uz) {
+    double f[3] = {cx - ex, cy - ey, cz - ez};
+    double fl = sqrt(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+    for (int i = 0; i < 3; i++) f[i] /= fl;
+    double s[3] = {f[1] * uz - f[2] * uy, f[2] * ux - f[0] * uz, f[0] * uy - f[1] * ux};
+    double sl = sqrt(s[0] * s[0] + s[1] * s[1] + s[2] * s[2]);
+    for (int i = 0; i < 3; i++) s[i] /= sl;
+    double u[3] = {s[1] * f[2] - s[2] * f[1], s[2] * f[0] - s[0] * f[2], s[0] * f[1] - s[1] * f[0]};
+
+    Mat4 m = identityMatrix();
+    for (int i = 0; i < 3; i++) {
+        m.m[i * 4 + 0] = (float)s[i];
+        m.m[i * 4 + 1] = (float)u[i];
+        m.m[i * 4 + 2] = (float)-f[i];
+    }
+    multCurrent(m);
+    glTranslatef((float)-ex, (float)-ey, (float)-ez);
+}
+
+void glViewport(GLint x, GLint y, GLsizei w, GLsizei h) {
+    ctx->vpX = x;
+    ctx->vpY = y;
+    ctx->vpW = w;
+    ctx->vpH = h;
+}
+
+void glEnable(GLenum cap) {
+    if (cap == GL_DEPTH_TEST) ctx->depthTest = true;
+    if (cap == GL_CULL_FACE) ctx->cullFace = true;
+}
+
+void glDisable(GLenum cap) {
+    if (cap == GL_DEPTH_TEST) ctx->depthTest = false;
+    if (cap == GL_CULL_FACE) ctx->cullFace = false;
+}
+
+void glPushAttrib(GLbitfield mask) {
+    Context::Attrib a;
+    a.mask = mask;
+    a.depthTest = ctx->depthTest;
+    a.cullFace = ctx->cullFace;
+    a.color = ctx->currentColor;
+    ctx->attribStack.push_back(a);
+}
+
+void glPopAttrib(void) {
+    if (ctx->attribStack.empty()) return;
+    Context::Attrib a = ctx->attribStack.back();
+    ctx->attribStack.pop_back();
+    if (a.mask & GL_ENABLE_BIT) {
+        ctx->depthTest = a.depthTest;
+        ctx->cullFace = a.cullFace;
+    }
+    if (a.mask & GL_CURRENT_BIT) ctx->currentColor = a.color;
+}
+
+void glDepthFunc(GLenum func) { ctx->depthFunc = func; }
+void glDepthMask(GLboolean flag) { ctx->depthMask = flag != 0; }
+void glCullFace(GLenum mode) { ctx->cullMode = mode; }
+void glFrontFace(GLenum mode) { ctx->frontFace = mode; }
+void glLineWidth(GLfloat width) { ctx->lineWidth = width; }
+void glPointSize(GLfloat size) { ctx->pointSize = size; }
+
+// Accepted for compatibility, no effect on flat-colored output
+void glShadeModel(GLenum) {}
+void glHint(GLenum, GLenum) {}
+void glLightfv(GLenum, GLenum, const GLfloat *) {}
+
+void glRasterPos2f(GLfloat x, GLfloat y) {
+    Mat4 m = multiply(ctx->projection.back(), ctx->modelview.back());
+    float cx = m.m[0] * x + m.m[4] * y + m.m[12];
+    float cy = m.m[1] * x + m.m[5] * y + m.m[13];
+    float cz = m.m[2] * x + m.m[6] * y + m.m[14];
+    float cw = m.m[3] * x + m.m[7] * y + m.m[15];
+    ctx->rasterValid = cw > 0.0f && fabsf(cx) <= cw && fabsf(cy) <= cw && fabsf(cz) <= cw;
+    if (!ctx->rasterValid) return;
+    ctx->rasterX = ctx->vpX + (cx / cw + 1.0f) * 0.5f * ctx->vpW;
+    ctx->rasterY = ctx->vpY + (cy / cw + 1.0f) * 0.5f * ctx->vpH;
+}
+void glRasterPos2i(GLint x, GLint y) { glRasterPos2f((float)x, (float)y); }
+
+// Color only, written in order after everything submitted so far;
+// no depth test or pixel zoom
+void glDrawPixels(GLsizei w, GLsizei h, GLenum format, GLenum type, const GLvoid *pixels) {
+    if (!ctx->rasterValid || type != GL_UNSIGNED_BYTE || (format != GL_RGBA && format != GL_RGB)) return;
+    flush();
+
+    int channels = format == GL_RGBA ? 4 : 3;
+    size_t rowBytes = (size_t)w * channels;
+    size_t align = ctx->unpackAlignment > 0 ? ctx->unpackAlignment : 1;
+    size_t pitch = (rowBytes + align - 1) / align * align;
+    int x0 = (int)floorf(ctx->rasterX + 0.5f), y0 = (int)floorf(ctx->rasterY + 0.5f);
+
+    for (int row = 0; row < h; row++) {
+        int dy = y0 + row;
+        if (dy < 0 || dy >= ctx->height) continue;
+        const unsigned char *src = (const unsigned char *)pixels + row * pitch;
+        uint32_t *dst = &ctx->color[(size_t)dy * ctx->stride];
+        for (int col = 0; col < w; col++) {
+            int dx = x0 + col;
+            if (dx < 0 || dx >= ctx->width) continue;
+            const unsigned char *p = src + col * channels;
+            dst[dx] = p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)(channels == 4 ? p[3] : 255) << 24;
+        }
+    }
+}
+
+// Display lists only ever hold bitmap text, which is not rasterized, so a
+// list records nothing and calling it draws nothing
+GLuint glGenLists(GLsizei range) {
+    GLuint first = ctx->nextList;
+    ctx->nextList += range;
+    return first;
+}
+void glNewList(GLuint, GLenum mode) { ctx->compiling = mode == GL_COMPILE; }
+void glEndList(void) { ctx->compiling = false; }
+void glCallList(GLuint) {}
+void glDeleteLists(GLuint, GLsizei) {}
+
+void glFlush(void) { flush(); }
+void glFinish(void) { flush(); }
+
+void glPixelStorei(GLenum pname, GLint param) {
+    if (pname == GL_PACK_ALIGNMENT) ctx->packAlignment = param;
+    if (pname == GL_UNPACK_ALIGNMENT) ctx->unpackAlignment = param;
+}
+
+void glReadPixels(GLint x, GLint y, GLsizei w, GLsizei h, GLenum format, GLenum type, GLvoid *pixels) {
+    flush();
+    if (type != GL_UNSIGNED_BYTE || (format != GL_RGBA && format != GL_RGB)) return;
+
+    int channels = format == GL_RGBA ? 4 : 3;
+    size_t rowBytes = (size_t)w * channels;
+    size_t align = ctx->packAlignment > 0 ? ctx->packAlignment : 1;
+    size_t pitch = (rowBytes + align - 1) / align * align;
+
+    for (int row = 0; row < h; row++) {
+        unsigned char *dst = (unsigned char *)pixels + row * pitch;
+        int sy = y + row;
+        for (int col = 0; col < w; col++) {
+            int sx = x + col;
+            uint32_t c = 0;
+            if (sx >= 0 && sy >= 0 && sx < ctx->width && sy < ctx->height) c = ctx->color[(size_t)sy * ctx->stride + sx];
+            for (int k = 0; k < channels; k++) dst[col * channels + k] = (unsigned char)(c >> (8 * k));
+        }
+    }
+}
+
+const GLubyte *glGetString(GLenum name) {
+    static char renderer[64];
+    switch (name) {
+        case GL_VENDOR:
+            return (const GLubyte *)"NKUST_ComputerGraphics";
+        case GL_RENDERER:
+            snprintf(renderer, sizeof(renderer), "softgl (%d threads)", ctx ? ctx->threads : 0);
+            return (const GLubyte *)renderer;
+        case GL_VERSION:
+            return (const GLubyte *)"1.1 softgl";
+    }
+    return (const GLubyte *)"";
+}
+
+GLenum glGetError(void) { return GL_NO_ERROR; }
+
+// No window system: swap control and extensions are never available
+void (*glXGetProcAddressARB(const GLubyte *))(void) { return 0; }
+
+}  // extern "C"
@@ -0,0 +1,24 @@
+#ifndef SOFTGL_H
+#define SOFTGL_H
+
+// CPU rasterizer implementing the fixed-function GL subset the homework
+// programs use. softgl.cpp defines the gl*/glu* entry points itself, so a
+// program linked against it instead of libGL renders into an in-memory
+// framebuffer without any GL driver.
+//
+// Supported: GL_POINTS, GL_LINES, GL_LINE_LOOP, GL_LINE_STRIP, GL_TRIANGLES,
+// GL_TRIANGLE_FAN, GL_TRIANGLE_STRIP, GL_QUADS, GL_POLYGON, client vertex
+// arrays, the modelview/projection stacks, depth test, back-face culling,
+// flat color and glDrawPixels(). Lighting, text and textures are accepted
+// and ignored.
+//
+// Primitives are binned into 64x64 tiles as they are submitted. glFlush(),
+// glFinish() and glReadPixels() rasterize all tiles in submission order,
+// spread over worker threads; triangles are filled with SSE edge functions,
+// four pixels at a time.
+
+// Allocates the framebuffer and makes the (single) context current
+bool softglCreateContext(int width, int height, int threads);
+void softglDestroyContext();
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef TESSELLATOR_H
+#define TESSELLATOR_H
+
+// Adaptive circle tessellation shared by Hw_01 and Hw_02.
+//
+// The segment count is the smallest N whose chord error (sagitta)
+// r * (1 - cos(pi / N)) stays below a pixel tolerance for the projected
+// radius r. Unit-circle vertex tables are cached per (radius bucket,
+// tolerance), with buckets a quarter octave wide and rounded up, so the
+// error bound holds for every radius in the bucket.
+
+#include <cmath>
+#include <map>
+#include <utility>
+#include <vector>
+
+const int TESS_MIN_SEGMENTS = 8;
+const int TESS_MAX_SEGMENTS = 1 << 16;
+
+inline int circleSegments(float radiusPx, float tolerancePx) {
+    const double PI = 3.14159265358979323846;
+    if (radiusPx <= tolerancePx) return TESS_MIN_SEGMENTS;
+
+    double n = ceil(PI / acos(1.0 - (double)tolerancePx / radiusPx));
+    if (n < TESS_MIN_SEGMENTS) return TESS_MIN_SEGMENTS;
+    if (n > TESS_MAX_SEGMENTS) return TESS_MAX_SEGMENTS;
+    return (int)n;
+}
+
+class CircleTessellator {
+public:
+    CircleTessellator() : hits(0), misses(0) {}
+
+    // Unit circle as (cos, sin) pairs for a circle of radiusPx pixels;
+    // the vertex count is size() / 2
+    const std::vector<float> &unitCircle(float radiusPx, float tolerancePx) {
+        int bucket = (int)ceil(4.0 * log2(radiusPx > 1.0f ? radiusPx : 1.0f));
+        int tol = (int)(tolerancePx * 16.0f + 0.5f);
+        std::pair<int, int> key(bucket, tol > 0 ? tol : 1);
+
+        std::map<std::pair<int, int>, std::vector<float> >::iterator it = cache.find(key);
+        if (it != cache.end()) {
+            hits++;
+            return it->second;
+        }
+        misses++;
+
+        float bucketRadius = (float)pow(2.0, bucket / 4.0);
+        int segments = circleSegments(bucketRadius, key.second / 16.0f);
+        std::vector<float> &v = cache[key];
+        v.resize(2 * segments);
+
+        // Same incremental rotation as Hw_01's polygon
+        double step = 2.0 * 3.14159265358979323846 / segments;
+        double cd = cos(step), sd = sin(step);
+        double c = 1.0, s = 0.0;
+        for (int i = 0; i < segments; i++) {
+            v[2 * i] = (float)c;
+            v[2 * i + 1] = (float)s;
+            double nc = c * cd - s * sd;
+            s = c * sd + s * cd;
+            c = nc;
+        }
+        return v;
+    }
+
+    size_t cachedTables() const { return cache.size(); }
+
+    long hits;
+    long misses;
+
+private:
+    std::map<std::pair<int, int>, std::vector<float> > cache;
+};
+
+#endif
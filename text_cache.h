@@ -0,0 +1,89 @@
+#ifndef TEXT_CACHE_H
+#define TEXT_CACHE_H
+
+// Cached bitmap text for the HUDs of Hw_02..Hw_04.
+//
+// GLUT only exposes its fonts through glutBitmapCharacter(), so glyphs are
+// cached where GL 1.1 can keep them: a string's glBitmap calls are compiled
+// once into a display list and its width is measured at the same time.
+// Drawing it is then a glRasterPos plus one glCallList. Static strings are
+// looked up by content; dynamic ones (counters, timers) own a numbered slot
+// whose list is recompiled only when the text actually changes.
+//
+// Layouts are built lazily, so the first draw needs a current GL context.
+
+#include <map>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+
+#include "glut.h"
+#else
+#include <GL/glut.h>
+#endif
+
+struct TextLayout {
+    GLuint list;
+    int width;  // pixels, sum of glutBitmapWidth()
+    void *font;
+    std::string text;
+};
+
+class TextCache {
+public:
+    TextCache() : builds(0) {}
+
+    const TextLayout &layout(void *font, const std::string &text) {
+        std::pair<void *, std::string> key(font, text);
+        std::map<std::pair<void *, std::string>, TextLayout>::iterator it = layouts.find(key);
+        if (it != layouts.end()) return it->second;
+
+        TextLayout &t = layouts[key];
+        t.list = 0;
+        build(t, font, text);
+        return t;
+    }
+
+    const TextLayout &slot(int id, void *font, const std::string &text) {
+        std::map<int, TextLayout>::iterator it = slots.find(id);
+        if (it == slots.end()) {
+            TextLayout &t = slots[id];
+            t.list = 0;
+            build(t, font, text);
+            return t;
+        }
+        if (it->second.font != font || it->second.text != text) build(it->second, font, text);
+        return it->second;
+    }
+
+    // x, y in the coordinates of the current matrices, like glRasterPos2f
+    static void draw(const TextLayout &t, float x, float y) {
+        glRasterPos2f(x, y);
+        glCallList(t.list);
+    }
+
+    long builds;  // display list compilations
+
+private:
+    void build(TextLayout &t, void *font, const std::string &text) {
+        if (t.list == 0) t.list = glGenLists(1);
+        t.font = font;
+        t.text = text;
+        t.width = 0;
+
+        glNewList(t.list, GL_COMPILE);
+        for (size_t i = 0; i < text.size(); i++) {
+            glutBitmapCharacter(font, (unsigned char)text[i]);
+            t.width += glutBitmapWidth(font, (unsigned char)text[i]);
+        }
+        glEndList();
+        builds++;
+    }
+
+    std::map<std::pair<void *, std::string>, TextLayout> layouts;
+    std::map<int, TextLayout> slots;
+};
+
+#endif
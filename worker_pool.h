@@ -0,0 +1,83 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+// Threads started once and woken for each job, so per-frame work does not
+// pay for creating and joining threads. run(n, f) calls f(0) .. f(n - 1)
+// at the same time, f(0) on the calling thread, and returns when all of
+// them have. One job at a time, from one thread.
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPool {
+public:
+    explicit WorkerPool(int n) : job(NULL), jobSize(0), generation(0), pending(0), quit(false) {
+        for (int i = 1; i < n; i++) threads.push_back(std::thread(&WorkerPool::work, this, i));
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            quit = true;
+        }
+        wake.notify_all();
+        for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+    }
+
+    int size() const { return (int)threads.size() + 1; }
+
+    void run(int n, const std::function<void(int)> &f) {
+        n = std::min(n, size());
+        if (n <= 1) {
+            if (n == 1) f(0);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m);
+            job = &f;
+            jobSize = n;
+            pending = n - 1;
+            generation++;
+        }
+        wake.notify_all();
+        f(0);
+        std::unique_lock<std::mutex> lock(m);
+        done.wait(lock, [this] { return pending == 0; });
+    }
+
+private:
+    void work(int index) {
+        unsigned seen = 0;
+        for (;;) {
+            const std::function<void(int)> *f;
+            int n;
+            {
+                std::unique_lock<std::mutex> lock(m);
+                wake.wait(lock, [&] { return quit || generation != seen; });
+                if (quit) return;
+                seen = generation;
+                f = job;
+                n = jobSize;
+            }
+            if (index >= n) continue;  // not needed for this job
+            (*f)(index);
+            std::lock_guard<std::mutex> lock(m);
+            if (--pending == 0) done.notify_one();
+        }
+    }
+
+    std::vector<std::thread> threads;
+    std::mutex m;
+    std::condition_variable wake, done;
+    const std::function<void(int)> *job;
+    int jobSize;
+    unsigned generation;
+    int pending;
+    bool quit;
+};
+
+#endif